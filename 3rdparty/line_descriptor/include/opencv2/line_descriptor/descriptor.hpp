@@ -184,6 +184,8 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
 {
 
  public:
+  class EDLineDetector;
+
   /** @brief List of BinaryDescriptor parameters:
   */
   struct CV_EXPORTS Params
@@ -300,6 +302,36 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
   void compute( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors, bool returnFloatDescr =
                     false ) const;
 
+  /** @brief Requires descriptors computation from precomputed Sobel's derivatives
+
+    The derivatives must have been computed (CV_16SC1, 3x3 Sobel) on the same smoothed Gaussian
+    pyramid that *compute* would build internally, so that descriptors are identical while the
+    pyramid and gradients can be shared with other consumers of the same image.
+
+    @param dxImages Sobel's derivatives along X, one for each octave referenced by *keylines*
+    @param dyImages Sobel's derivatives along Y, one for each octave referenced by *keylines*
+    @param keylines vector containing lines for which descriptors must be computed
+    @param descriptors
+    @param returnFloatDescr flag (when set to true, original non-binary descriptors are returned)
+     */
+  void computeFromGradients( const std::vector<Mat>& dxImages, const std::vector<Mat>& dyImages, CV_OUT CV_IN_OUT std::vector<KeyLine>& keylines,
+                             CV_OUT Mat& descriptors, bool returnFloatDescr = false ) const;
+
+  /** @brief Requires descriptors computation reusing the gradients of the EDLineDetector that
+    extracted the lines
+
+    Lines must have been detected by *detector* on a single octave (octave 0), so that Sobel's
+    derivatives it stored while running EDline can be used directly and no new derivatives are
+    computed.
+
+    @param detector EDLineDetector on which EDline has been called for the image containing *keylines*
+    @param keylines vector containing lines for which descriptors must be computed
+    @param descriptors
+    @param returnFloatDescr flag (when set to true, original non-binary descriptors are returned)
+     */
+  void computeFromDetector( const EDLineDetector& detector, CV_OUT CV_IN_OUT std::vector<KeyLine>& keylines, CV_OUT Mat& descriptors,
+                            bool returnFloatDescr = false ) const;
+
   /** @brief Return descriptor size
    */
   int descriptorSize() const;
@@ -335,6 +367,9 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
   virtual void computeImpl( const Mat& imageSrc, std::vector<KeyLine>& keylines, Mat& descriptors, bool returnFloatDescr,
                             bool useDetectionData ) const;
 
+  /** computation of descriptors once gradients are available */
+  void computeDescriptors( std::vector<KeyLine>& keylines, Mat& descriptors, bool returnFloatDescr, bool useDetectionData ) const;
+
  //private:
   /** struct to represent lines extracted from an octave */
   struct OctaveLine
@@ -1081,8 +1116,9 @@ void add( const std::vector<Mat>& descriptors );
 
 /** @brief Update dataset by inserting into it all descriptors that were stored locally by *add* function.
 
-@note Every time this function is invoked, current dataset is deleted and locally stored descriptors
-are inserted into dataset. The locally stored copy of just inserted descriptors is then removed.
+@note When new descriptors have been added since last invocation, current dataset is deleted and
+rebuilt from all the descriptors added since construction (or last *clear*). Otherwise dataset is
+kept, so that it can be built once and queried many times.
  */
 void train();
 
@@ -1103,36 +1139,14 @@ BinaryDescriptorMatcher();
 /** destructor */
 ~BinaryDescriptorMatcher()
 {
+  delete dataset;
 }
 
 private:
-class BucketGroup
-{
-
-public:
-/** constructor */
-BucketGroup();
-
-/** destructor */
-~BucketGroup();
-
-/** insert data into the bucket */
-void insert( int subindex, UINT32 data );
-
-/** perform a query to the bucket */
-UINT32* query( int subindex, int *size );
-
-/** utility functions */
-void insert_value( std::vector<uint32_t>& vec, int index, UINT32 data );
-void push_value( std::vector<uint32_t>& vec, UINT32 Data );
-
-/** data fields */
-UINT32 empty;
-std::vector<uint32_t> group;
-
-
-};
-
+/** hashtable stored in compressed (CSR) form: the codes of key i are
+ values[offsets[i] .. offsets[i+1]). It is filled in two passes over the
+ data, a counting pass (*count*) and a scatter pass (*insert*) separated
+ by *allocate* */
 class SparseHashtable
 {
 
@@ -1141,8 +1155,11 @@ private:
 /** Maximum bits per key before folding the table */
 static const int MAX_B;
 
-/** Bins (each bin is an Array object for duplicates of the same key) */
-BucketGroup *table;
+/** start of each key's bucket in values (size + 2 entries while building) */
+std::vector<UINT32> offsets;
+
+/** codes' indices, grouped by key */
+std::vector<UINT32> values;
 
 public:
 
@@ -1155,11 +1172,17 @@ SparseHashtable();
 /** initializer */
 int init( int _b );
 
-/** insert data */
+/** first pass: count one entry for a key */
+void count( UINT64 index );
+
+/** turn counts into bucket offsets and allocate values */
+void allocate();
+
+/** second pass: insert data (keys must have been counted) */
 void insert( UINT64 index, UINT32 data );
 
 /** query data */
-UINT32* query( UINT64 index, int* size );
+const UINT32* query( UINT64 index, int* size ) const;
 
 /** Bits per index */
 int b;
@@ -1263,17 +1286,34 @@ UINT64 N;
 /** Table of original full-length codes */
 cv::Mat codes;
 
-/** Counter for eliminating duplicate results (it is not thread safe) */
-bitarray *counter;
-
 /** Array of m hashtables */
 SparseHashtable *H;
 
 /** Volume of a b-bit Hamming ball with radius s (for s = 0 to d) */
 UINT32 *xornum;
 
-/** Used within generation of binary codes at a certain Hamming distance */
-int power[100];
+/** Per-thread scratch state of a query; lets several queries run on the same
+ tables concurrently */
+struct QueryState
+{
+  /** generation stamp of the last query that visited each code, used for
+   eliminating duplicate results without clearing a bitarray per query */
+  std::vector<UINT32> stamp;
+
+  /** current generation */
+  UINT32 generation;
+
+  /** per-distance result buckets (K * (D + 1)) */
+  std::vector<UINT32> res;
+
+  /** query split into m substrings */
+  std::vector<UINT64> chunks;
+
+  /** Used within generation of binary codes at a certain Hamming distance */
+  int power[100];
+
+  QueryState() : generation( 0 ) {}
+};
 
 /** constructor */
 Mihasher();
@@ -1290,13 +1330,18 @@ void setK( int K );
 /** populate tables */
 void populate( cv::Mat & codes, UINT32 N, int dim1codes );
 
-/** execute a batch query */
+/** execute a batch query (rows are processed in parallel) */
 void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq, int dim1queries );
 
+/** prepare a state for queries on current tables */
+void initQueryState( QueryState& st ) const;
+
+/** execute a single query; safe to call concurrently with distinct states */
+void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, const UINT8 *q, QueryState& st ) const;
+
 private:
 
-/** execute a single query */
-void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, UINT8 *q, UINT64 * chunks, UINT32 * res );
+class BatchQueryBody;
 };
 
 /** retrieve Hamming distances */
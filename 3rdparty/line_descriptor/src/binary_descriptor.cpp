@@ -561,6 +561,81 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
 
   BinaryDescriptor* bd = const_cast<BinaryDescriptor*>( this );
 
+  /* get maximum octave */
+  int octaveIndex = -1;
+  for ( size_t l = 0; l < keylines.size(); l++ )
+  {
+    if( keylines[l].octave > octaveIndex )
+      octaveIndex = keylines[l].octave;
+  }
+
+  if( !useDetectionData )
+    bd->computeSobel( image, octaveIndex + 1 );
+
+  computeDescriptors( keylines, descriptors, returnFloatDescr, useDetectionData );
+}
+
+/* requires descriptors computation from precomputed Sobel's derivatives */
+void BinaryDescriptor::computeFromGradients( const std::vector<Mat>& dxImages, const std::vector<Mat>& dyImages, CV_OUT CV_IN_OUT std::vector<KeyLine>& keylines,
+                                             CV_OUT Mat& descriptors, bool returnFloatDescr ) const
+{
+  /* keypoints list can't be empty */
+  if( keylines.size() == 0 )
+  {
+    std::cout << "Error: keypoint list is empty" << std::endl;
+    return;
+  }
+
+  /* check that every octave referenced by a KeyLine has its derivatives */
+  if( dxImages.size() != dyImages.size() )
+    throw std::runtime_error( "Error, different number of X and Y derivatives" );
+
+  for ( size_t l = 0; l < keylines.size(); l++ )
+  {
+    if( keylines[l].octave >= (int) dxImages.size() )
+      throw std::runtime_error( "Error, missing derivatives for some octave" );
+  }
+
+  for ( size_t i = 0; i < dxImages.size(); i++ )
+  {
+    if( dxImages[i].type() != CV_16SC1 || dyImages[i].type() != CV_16SC1 || dxImages[i].size() != dyImages[i].size() )
+      throw std::runtime_error( "Error, derivatives must be CV_16SC1 matrices of the same size" );
+  }
+
+  BinaryDescriptor* bd = const_cast<BinaryDescriptor*>( this );
+
+  /* share derivatives (no copy) */
+  bd->images_sizes.clear();
+  bd->dxImg_vector.clear();
+  bd->dyImg_vector.clear();
+  for ( size_t i = 0; i < dxImages.size(); i++ )
+  {
+    bd->images_sizes.push_back( dxImages[i].size() );
+    bd->dxImg_vector.push_back( dxImages[i] );
+    bd->dyImg_vector.push_back( dyImages[i] );
+  }
+
+  computeDescriptors( keylines, descriptors, returnFloatDescr, false );
+}
+
+/* requires descriptors computation from the derivatives stored by an EDLineDetector */
+void BinaryDescriptor::computeFromDetector( const EDLineDetector& detector, CV_OUT CV_IN_OUT std::vector<KeyLine>& keylines, CV_OUT Mat& descriptors,
+                                            bool returnFloatDescr ) const
+{
+  if( detector.dxImg_.rows != (int) detector.imageHeight || detector.dxImg_.cols != (int) detector.imageWidth )
+    throw std::runtime_error( "Error, EDline has not been run on the detector" );
+
+  std::vector<Mat> dxImages( 1, detector.dxImg_ );
+  std::vector<Mat> dyImages( 1, detector.dyImg_ );
+  computeFromGradients( dxImages, dyImages, keylines, descriptors, returnFloatDescr );
+}
+
+/* computation of descriptors once gradients are available */
+void BinaryDescriptor::computeDescriptors( std::vector<KeyLine>& keylines, Mat& descriptors, bool returnFloatDescr, bool useDetectionData ) const
+{
+
+  BinaryDescriptor* bd = const_cast<BinaryDescriptor*>( this );
+
   /* get maximum class_id and octave*/
   int numLines = 0;
   int octaveIndex = -1;
@@ -573,9 +648,6 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
       octaveIndex = keylines[l].octave;
   }
 
-  if( !useDetectionData )
-    bd->computeSobel( image, octaveIndex + 1 );
-
   /* create a ScaleLines object */
   OctaveSingleLine fictiousOSL;
 //  fictiousOSL.octaveCount = params.numOfOctave_ + 1;
@@ -42,8 +42,6 @@
 #include "precomp.hpp"
 
 #define MAX_B 37
-double ARRAY_RESIZE_FACTOR = 1.1;    // minimum is 1.0
-double ARRAY_RESIZE_ADD_FACTOR = 4;  // minimum is 1
 
 //using namespace cv;
 namespace cv
@@ -85,11 +83,16 @@ void BinaryDescriptorMatcher::train()
   if( !dataset )
     dataset = new Mihasher( 256, 32 );
 
-  if( descriptorsMat.rows > 0 )
-    dataset->populate( descriptorsMat, descriptorsMat.rows, descriptorsMat.cols );
+  /* dataset is up to date: keep it, so that it can be queried many times */
+  if( descriptorsMat.rows == descrInDS )
+    return;
 
+  /* rebuild dataset from all descriptors added so far, so that indexes
+   stay consistent with indexesMap (tables are never populated twice) */
+  delete dataset;
+  dataset = new Mihasher( 256, 32 );
+  dataset->populate( descriptorsMat, descriptorsMat.rows, descriptorsMat.cols );
   descrInDS = descriptorsMat.rows;
-  descriptorsMat.release();
 }
 
 /* clear dataset and internal data */
@@ -97,6 +100,7 @@ void BinaryDescriptorMatcher::clear()
 {
   descriptorsMat.release();
   indexesMap.clear();
+  delete dataset;
   dataset = 0;
   nextAddedIndex = 0;
   numImages = 0;
@@ -592,47 +596,60 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
 
 }
 
-/* execute a batch query */
-void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+/* runs queries over a range of rows, with one scratch state per stripe */
+class BinaryDescriptorMatcher::Mihasher::BatchQueryBody : public cv::ParallelLoopBody
 {
-  /* create and initialize a bitarray */
-  counter = new bitarray;
-  counter->init( N );
-
-  UINT32 *res = new UINT32[K * ( D + 1 )];
-  UINT64 *chunks = new UINT64[m];
-  UINT32 * presults = results;
-  UINT32 *pnumres = numres;
-
-  /* make a copy of input queries */
-  cv::Mat queries_clone = queries.clone();
-
-  /* set a pointer to first query (row) */
-  UINT8 *pq = queries_clone.ptr();
-
-  /* loop over number of descriptors */
-  for ( size_t i = 0; i < numq; i++ )
+ public:
+  BatchQueryBody( const Mihasher* _mih, UINT32* _results, UINT32* _numres, const cv::Mat& _queries, int _dim1queries ) :
+      mih( _mih ),
+      results( _results ),
+      numres( _numres ),
+      queries( _queries ),
+      dim1queries( _dim1queries )
   {
-    /* for every descriptor, query database */
-    query( presults, pnumres, pq, chunks, res );
-
-    /* move pointer to write next K indeces */
-    presults += K;
-    pnumres += B + 1;
+  }
 
-    /* move forward pointer to current row in descriptors matrix */
-    pq += dim1queries;
+  void operator()( const cv::Range& range ) const
+  {
+    QueryState st;
+    mih->initQueryState( st );
 
+    for ( int i = range.start; i < range.end; i++ )
+    {
+      /* each row writes K indices and B+1 counters at its own offset */
+      const UINT8* pq = queries.ptr() + (size_t) i * dim1queries;
+      mih->query( results + (size_t) i * mih->K, numres + (size_t) i * ( mih->B + 1 ), pq, st );
+    }
   }
 
-  delete[] res;
-  delete[] chunks;
+ private:
+  const Mihasher* mih;
+  UINT32* results;
+  UINT32* numres;
+  const cv::Mat& queries;
+  int dim1queries;
+};
 
-  delete counter;
+/* execute a batch query */
+void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+{
+  /* queries are only read, so rows are shared by all workers without a copy;
+   one stripe per thread keeps the number of scratch states small */
+  cv::parallel_for_( cv::Range( 0, (int) numq ), BatchQueryBody( this, results, numres, queries, dim1queries ),
+                     std::max( 1, cv::getNumThreads() ) );
+}
+
+/* prepare a state for queries on current tables */
+void BinaryDescriptorMatcher::Mihasher::initQueryState( QueryState& st ) const
+{
+  st.stamp.assign( (size_t) N, 0 );
+  st.generation = 0;
+  st.res.resize( (size_t) K * ( D + 1 ) );
+  st.chunks.resize( m );
 }
 
 /* execute a single query */
-void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, UINT8 * Query, UINT64 *chunks, UINT32 *res )
+void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, const UINT8 * Query, QueryState& st ) const
 {
   /* if K == 0 that means we want everything to be processed.
    So maxres = N in that case. Otherwise K limits the results processed */
@@ -649,12 +666,25 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   UINT32 nl = 0;
 
   UINT32 nd = 0;
-  UINT32 *arr;
+  const UINT32 *arr;
   int size = 0;
   UINT32 index;
   int hammd;
 
-  counter->erase();
+  UINT32 *res = st.res.data();
+  UINT64 *chunks = st.chunks.data();
+  int *power = st.power;
+  UINT32 *stamp = st.stamp.data();
+
+  /* a new generation invalidates all stamps of the previous query;
+   stamps are only cleared when the counter wraps around */
+  if( ++st.generation == 0 )
+  {
+    std::fill( st.stamp.begin(), st.stamp.end(), 0 );
+    st.generation = 1;
+  }
+  const UINT32 gen = st.generation;
+
   memset( numres, 0, ( B + 1 ) * sizeof ( *numres ) );
 
   split( chunks, Query, m, mplus, b );
@@ -712,9 +742,9 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
             for ( int c = 0; c < size; c++ )
             {
               index = arr[c];
-              if( !counter->get( index ) )
+              if( stamp[index] != gen )
               { /* if it is not a duplicate */
-                counter->set( index );
+                stamp[index] = gen;
                 hammd = cv::line_descriptor::match( codes.ptr() + (UINT64) index * ( B_over_8 ), Query, B_over_8 );
 
                 nc++;
@@ -803,16 +833,27 @@ void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val
   codes = _codes;
   UINT64 * chunks = new UINT64[m];
 
+  /* counting pass (tables are empty since construction) */
   UINT8 * pcodes = codes.ptr();
   for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
   {
     split( chunks, pcodes, m, mplus, b );
 
     for ( int k = 0; k < m; k++ )
-      H[k].insert( chunks[k], (UINT32) i );
+      H[k].count( chunks[k] );
+  }
+
+  for ( int k = 0; k < m; k++ )
+    H[k].allocate();
 
-    if( i % (int) ceil( N / 1000.0 ) == 0 )
-      fflush (stdout);
+  /* scatter pass, codes keep their order inside each bucket */
+  pcodes = codes.ptr();
+  for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
+  {
+    split( chunks, pcodes, m, mplus, b );
+
+    for ( int k = 0; k < m; k++ )
+      H[k].insert( chunks[k], (UINT32) i );
   }
 
   delete[] chunks;
@@ -821,7 +862,6 @@ void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val
 /* constructor */
 BinaryDescriptorMatcher::SparseHashtable::SparseHashtable()
 {
-  table = NULL;
   size = 0;
   b = 0;
 }
@@ -834,8 +874,11 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
   if( b < 5 || b > MAX_B || b > (int) ( sizeof(UINT64) * 8 ) )
     return 1;
 
-  size = UINT64_1 << ( b - 5 );  // size = 2 ^ b
-  table = (BucketGroup*) calloc( (size_t)size, sizeof(BucketGroup) );
+  size = UINT64_1 << b;  // size = 2 ^ b
+
+  /* counts of key i are accumulated in offsets[i + 2] */
+  offsets.assign( (size_t) size + 2, 0 );
+  values.clear();
 
   return 0;
 
@@ -844,126 +887,37 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
 /* destructor */
 BinaryDescriptorMatcher::SparseHashtable::~SparseHashtable()
 {
-  free (table);
-}
-
-/* insert data */
-void BinaryDescriptorMatcher::SparseHashtable::insert( UINT64 index, UINT32 data )
-{
-  table[index >> 5].insert( (int) ( index % 32 ), data );
-}
-
-/* query data */
-UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size )
-{
-  return table[index >> 5].query( (int) ( index % 32 ), Size );
-}
-
-/* constructor */
-BinaryDescriptorMatcher::BucketGroup::BucketGroup()
-{
-  empty = 0;
-  group = std::vector < uint32_t > ( 2, 0 );
 }
 
-/* destructor */
-BinaryDescriptorMatcher::BucketGroup::~BucketGroup()
+/* count data */
+void BinaryDescriptorMatcher::SparseHashtable::count( UINT64 index )
 {
+  offsets[index + 2]++;
 }
 
-void BinaryDescriptorMatcher::BucketGroup::insert_value( std::vector<uint32_t>& vec, int index, UINT32 data )
+/* allocate buckets */
+void BinaryDescriptorMatcher::SparseHashtable::allocate()
 {
-  if( vec.size() > 1 )
-  {
-    if( vec[0] == vec[1] )
-    {
-      vec[1] = (UINT32) ceil( vec[0] * 1.1 );
-      for ( int i = 0; i < (int) ( 2 + vec[1] - vec.size() ); i++ )
-        vec.push_back( 0 );
-
-    }
-
-    vec.insert( vec.begin() + 2 + index, data );
-    vec[2 + index] = data;
-    vec[0]++;
-  }
+  /* after the prefix sum offsets[i + 1] is the start of key i; insert
+   advances it, so that it ends up as the start of key i + 1 */
+  for ( size_t i = 2; i < offsets.size(); i++ )
+    offsets[i] += offsets[i - 1];
 
-  else
-  {
-    vec = std::vector < uint32_t > ( 3, 0 );
-    vec[0] = 1;
-    vec[1] = 1;
-    vec[2] = data;
-  }
+  values.resize( offsets.back() );
 }
 
-void BinaryDescriptorMatcher::BucketGroup::push_value( std::vector<uint32_t>& vec, UINT32 Data )
-{
-  if( vec.size() > 0 )
-  {
-    if( vec[0] == vec[1] )
-    {
-      vec[1] = (UINT32) std::max( ceil( vec[1] * ARRAY_RESIZE_FACTOR ), vec[1] + ARRAY_RESIZE_ADD_FACTOR );
-      for ( int i = 0; i < (int) ( 2 + vec[1] - vec.size() ); i++ )
-        vec.push_back( 0 );
-    }
-
-    vec[2 + vec[0]] = Data;
-    vec[0]++;
-
-  }
-
-  else
-  {
-    vec = std::vector < uint32_t > ( 2 + (uint32_t) ARRAY_RESIZE_ADD_FACTOR, 0 );
-    vec[0] = 1;
-    vec[1] = 1;
-    vec[2] = Data;
-  }
-}
-
-/* insert data into the bucket */
-void BinaryDescriptorMatcher::BucketGroup::insert( int subindex, UINT32 data )
+/* insert data */
+void BinaryDescriptorMatcher::SparseHashtable::insert( UINT64 index, UINT32 data )
 {
-  if( group.size() == 0 )
-  {
-    push_value( group, 0 );
-  }
-
-  UINT32 lowerbits = ( (UINT32) 1 << subindex ) - 1;
-  int end = popcnt( empty & lowerbits );
-
-  if( ! ( empty & ( (UINT32) 1 << subindex ) ) )
-  {
-    insert_value( group, end, group[end + 2] );
-    empty |= (UINT32) 1 << subindex;
-  }
-
-  int totones = popcnt( empty );
-  insert_value( group, totones + 1 + group[2 + end + 1], data );
-
-  for ( int i = end + 1; i < totones + 1; i++ )
-    group[2 + i]++;
+  values[offsets[index + 1]++] = data;
 }
 
-/* perform a query to the bucket */
-UINT32* BinaryDescriptorMatcher::BucketGroup::query( int subindex, int *size )
+/* query data */
+const UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size ) const
 {
-  if( empty & ( (UINT32) 1 << subindex ) )
-  {
-    UINT32 lowerbits = ( (UINT32) 1 << subindex ) - 1;
-    int end = popcnt( empty & lowerbits );
-    int totones = popcnt( empty );
-
-    *size = group[2 + end + 1] - group[2 + end];
-    return & ( * ( group.begin() + 2 + totones + 1 + (int) group[2 + end] ) );
-  }
-
-  else
-  {
-    *size = 0;
-    return NULL;
-  }
+  UINT32 begin = offsets[index];
+  *Size = (int) ( offsets[index + 1] - begin );
+  return *Size ? &values[begin] : NULL;
 }
 
 }
@@ -80,15 +80,15 @@ namespace cv
 namespace line_descriptor
 {
 /*matching function */
-inline int match( UINT8*P, UINT8*Q, int codelb )
+inline int match( const UINT8*P, const UINT8*Q, int codelb )
 {
     int i, output = 0;
     for( i = 0; i <= codelb - 16; i += 16 )
     {
-        output += popcnt( *(UINT32*) (P+i) ^ *(UINT32*) (Q+i) ) +
-                  popcnt( *(UINT32*) (P+i+4) ^ *(UINT32*) (Q+i+4) ) +
-                  popcnt( *(UINT32*) (P+i+8) ^ *(UINT32*) (Q+i+8) ) +
-                  popcnt( *(UINT32*) (P+i+12) ^ *(UINT32*) (Q+i+12) );
+        output += popcnt( *(const UINT32*) (P+i) ^ *(const UINT32*) (Q+i) ) +
+                  popcnt( *(const UINT32*) (P+i+4) ^ *(const UINT32*) (Q+i+4) ) +
+                  popcnt( *(const UINT32*) (P+i+8) ^ *(const UINT32*) (Q+i+8) ) +
+                  popcnt( *(const UINT32*) (P+i+12) ^ *(const UINT32*) (Q+i+12) );
     }
     for( ; i < codelb; i++ )
         output += lookup[P[i] ^ Q[i]];
@@ -96,7 +96,7 @@ inline int match( UINT8*P, UINT8*Q, int codelb )
 }
 
 /* splitting function (b <= 64) */
-inline void split( UINT64 *chunks, UINT8 *code, int m, int mplus, int b )
+inline void split( UINT64 *chunks, const UINT8 *code, int m, int mplus, int b )
 {
   UINT64 temp = 0x0;
   int nbits = 0;
@@ -54,23 +54,31 @@ int main(int argc, char **argv)
     bbGrabber->grabStereo(img_l,img_r);
     StVO->initialize(img_l,img_r,0);
 
-    // run PL-StVO
+    // run PL-StVO (the grabber reuses its buffers, so the pairs are copied before grabbing the next)
     mrpt::utils::CTicTac clock;
+    Mat img_l_next, img_r_next;
+    bbGrabber->grabStereo(img_l,img_r);
+    img_l = img_l.clone();
+    img_r = img_r.clone();
     int frame_counter = 1;
     while(true)
     {
-        // Point-Line Tracking
+        // Point-Line Tracking, while the features of the next pair are extracted
         clock.Tic();
-        bbGrabber->grabStereo(img_l,img_r);
-        double t0 = 1000 * clock.Tac(); //ms
         StVO->insertStereoPair( img_l, img_r, frame_counter );
+        double t_ins  = 1000 * clock.Tac(); //ms
+        bbGrabber->grabStereo(img_l_next,img_r_next);
+        img_l_next = img_l_next.clone();
+        img_r_next = img_r_next.clone();
+        double t0 = 1000 * clock.Tac() - t_ins; //ms (grabbing)
+        StVO->prefetchStereoPair( img_l_next, img_r_next, frame_counter+1 );
         StVO->optimizePose();
         double t1 = 1000 * clock.Tac(); //ms
 
         // update scene
         scene.setText(frame_counter,t1,StVO->n_inliers_pt,StVO->matched_pt.size(),StVO->n_inliers_ls,StVO->matched_ls.size());
         scene.setCov( cov );
-        scene.setPose( StVO->curr_frame->DT );
+        scene.setPose( StVO->curr_frame->DT.matrix() );
         scene.setImage( img_l );
         scene.updateScene();
 
@@ -85,6 +93,8 @@ int main(int argc, char **argv)
 
         // update StVO
         StVO->updateFrame();
+        img_l = img_l_next;
+        img_r = img_r_next;
         frame_counter++;
 
     }
@@ -26,6 +26,7 @@
 
 #include <stereoFrame.h>
 #include <stereoFrameHandler.h>
+#include <stereoImageReader.h>
 #include <ctime>
 #include <boost/fusion/include/vector.hpp>
 #include <boost/fusion/include/at_c.hpp>
@@ -182,22 +183,37 @@ int main(int argc, char **argv)
     mrpt::utils::CTicTac clock;
     #endif
 
+    // image reader, decoding the following pairs in the background
+    vector<string> files_l, files_r;
+    for (std::map<std::string, std::string>::iterator it_l = sorted_imgs_l.begin(), it_r = sorted_imgs_r.begin();
+         it_l != sorted_imgs_l.end() && it_r != sorted_imgs_r.end(); ++it_l, ++it_r)
+    {
+        files_l.push_back( (img_dir_path_l / boost::filesystem::path(it_l->second.c_str())).string() );
+        files_r.push_back( (img_dir_path_r / boost::filesystem::path(it_r->second.c_str())).string() );
+    }
+    StereoImageReader reader( files_l, files_r );
+
     // initialize and run PL-StVO
-    int frame_counter = 0;
     double t1;
     StereoFrameHandler* StVO = new StereoFrameHandler(cam_pin);
-    for (std::map<std::string, std::string>::iterator it_l = sorted_imgs_l.begin(), it_r = sorted_imgs_r.begin();
-         it_l != sorted_imgs_l.end(), it_r != sorted_imgs_r.end(); ++it_l, ++it_r, frame_counter++)
+    Mat img_l, img_r, img_l_next, img_r_next;
+    bool has_next = reader.next( img_l_next, img_r_next );
+    for( int frame_counter = 0; has_next; frame_counter++ )
     {
-        // load images
-        boost::filesystem::path img_path_l = img_dir_path_l / boost::filesystem::path(it_l->second.c_str());
-        boost::filesystem::path img_path_r = img_dir_path_r / boost::filesystem::path(it_r->second.c_str());
-        Mat img_l( imread(img_path_l.string(), CV_8UC3) );  assert(!img_l.empty());
-        Mat img_r( imread(img_path_r.string(), CV_8UC3) );  assert(!img_r.empty());
+        // current pair, and the next one so that its features are extracted while this one is processed
+        string img_path_l = files_l[frame_counter];
+        img_l = img_l_next;
+        img_r = img_r_next;
+        has_next = reader.next( img_l_next, img_r_next );
+        bool prefetch = has_next && Config::pipelineDepth() > 0;
 
         // initialize (TODO: out of the for loop)
         if( frame_counter == 0 )
+        {
             StVO->initialize(img_l,img_r,0);
+            if( prefetch )
+                StVO->prefetchStereoPair( img_l_next, img_r_next, frame_counter+1 );
+        }
         // run
         else
         {
@@ -206,13 +222,15 @@ int main(int argc, char **argv)
             clock.Tic();
             #endif
             StVO->insertStereoPair( img_l, img_r, frame_counter );
+            if( prefetch )
+                StVO->prefetchStereoPair( img_l_next, img_r_next, frame_counter+1 );
 
             // set GT initial pose
             Matrix4d gt_inc = inverse_transformation( GTposes[frame_counter] ) * GTposes[frame_counter-1];
 
             // solve with robust kernel and IRLS
             StVO->optimizePose();
-            T_inc   = StVO->curr_frame->DT;
+            T_inc   = StVO->curr_frame->DT.matrix();
             cov     = StVO->curr_frame->DT_cov;
             cov_eig = StVO->curr_frame->DT_cov_eig;
 
@@ -225,7 +243,7 @@ int main(int argc, char **argv)
             scene->setText(frame_counter,t1,StVO->n_inliers_pt,StVO->matched_pt.size(),StVO->n_inliers_ls,StVO->matched_ls.size());
             scene->setCov( cov );
             scene->setPose( T_inc );
-            scene->setImage( img_path_l.string() );
+            scene->setImage( img_path_l );
             scene->setGT( GTposes[frame_counter] );
             scene->updateScene();
             #endif
@@ -244,6 +262,14 @@ int main(int argc, char **argv)
         }
     }
 
+    // a pair that could not be read cuts the sequence short
+    if( reader.failed() )
+    {
+        cerr << endl << "Could not read the stereo pair " << reader.failedIndex() << " of " << reader.size()
+             << ": \t" << reader.failedFile() << endl;
+        return -1;
+    }
+
     return 0;
 }
 
@@ -32,20 +32,22 @@ using namespace std;
 #include <eigen3/Eigen/Eigenvalues>
 using namespace Eigen;
 
-// Kinematics functions
-Matrix4d inverse_transformation(Matrix4d T);
-Matrix3d skew(Vector3d v);
-Matrix3d fast_skewexp(Vector3d v);
-Vector3d skewcoords(Matrix3d M);
-Matrix3d skewlog(Matrix3d M);
+#include <se3.h>
+
+// Kinematics functions (exp, log and inverse computed with StVO::SE3)
+Matrix4d inverse_transformation(const Matrix4d &T);
+Matrix3d skew(const Vector3d &v);
+Matrix3d fast_skewexp(const Vector3d &v);
+Vector3d skewcoords(const Matrix3d &M);
+Matrix3d skewlog(const Matrix3d &M);
 MatrixXd kroen_product(MatrixXd A, MatrixXd B);
-Matrix3d v_logmap(VectorXd x);
+Matrix3d v_logmap(const Vector3d &w);
 MatrixXd diagonalMatrix(MatrixXd M, unsigned int N);
-Matrix4d transformation_expmap(VectorXd x);
-VectorXd logarithm_map(Matrix4d T);
-Matrix4d transformation_expmap_approximate(VectorXd x);
-VectorXd logarithm_map_approximate(Matrix4d T);
-double diffManifoldError(Matrix4d T1, Matrix4d T2);
+Matrix4d transformation_expmap(const Vector6d &x);
+Vector6d logarithm_map(const Matrix4d &T);
+Matrix4d transformation_expmap_approximate(const Vector6d &x);
+Vector6d logarithm_map_approximate(const Matrix4d &T);
+double diffManifoldError(const Matrix4d &T1, const Matrix4d &T2);
 bool is_finite(const MatrixXd x);
 bool is_nan(const MatrixXd x);
 double angDiff(double alpha, double beta);
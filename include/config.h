@@ -21,6 +21,7 @@
 
 #pragma once
 #include <cmath>
+#include <string>
 
 class Config
 {
@@ -43,6 +44,16 @@ public:
     static bool&    scalePointsLines()  { return getInstance().scale_points_lines; }
     static bool&    useLevMarquardt()   { return getInstance().use_lev_marquardt; }
     static bool&    useUncertainty()    { return getInstance().use_uncertainty; }
+    static bool&    simdMatching()      { return getInstance().simd_matching; }
+    static bool&    epipolarSearch()    { return getInstance().epipolar_search; }
+    static bool&    f2fGridSearch()     { return getInstance().f2f_grid_search; }
+    static bool&    guidedMatching()    { return getInstance().guided_matching; }
+    static bool&    adaptiveMatching()  { return getInstance().adaptive_matching; }
+    static std::string& matcherModelFile() { return getInstance().matcher_model_file; }
+    static int&     poolThreads()       { return getInstance().pool_threads; }
+    static bool&    poolPinning()       { return getInstance().pool_pinning; }
+    static int&     pipelineDepth()     { return getInstance().pipeline_depth; }
+    static int&     parallelCostTh()    { return getInstance().parallel_cost_th; }
 
     // points detection and matching
     static int&     orbNFeatures()      { return getInstance().orb_nfeatures; }
@@ -52,6 +63,8 @@ public:
     static double&  minDisp()           { return getInstance().min_disp; }
     static double&  minRatio12P()       { return getInstance().min_ratio_12_p; }
     static double&  maxF2FDisp()        { return getInstance().max_f2f_disp; }
+    static double&  guidedWinK()        { return getInstance().guided_win_k; }
+    static double&  guidedMinWin()      { return getInstance().guided_min_win; }
 
     // lines detection and matching
     static int&     lsdRefine()         { return getInstance().lsd_refine; }
@@ -104,6 +117,16 @@ private:
     bool scale_points_lines;
     bool use_lev_marquardt;
     bool use_uncertainty;
+    bool simd_matching;
+    bool epipolar_search;
+    bool f2f_grid_search;
+    bool guided_matching;
+    bool adaptive_matching;
+    std::string matcher_model_file;
+    int  pool_threads;
+    bool pool_pinning;
+    int  pipeline_depth;
+    int  parallel_cost_th;
 
     // points detection and matching
     int    orb_nfeatures;
@@ -113,6 +136,8 @@ private:
     double min_disp;
     double min_ratio_12_p;
     double max_f2f_disp;
+    double guided_win_k;
+    double guided_min_win;
 
     // lines detection and matching
     int    lsd_refine;
@@ -0,0 +1,66 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/line_descriptor.hpp>
+using namespace cv;
+using namespace cv::line_descriptor;
+
+namespace StVO{
+
+// Right-image features bucketed by image row, so that the stereo candidates of a left feature
+// (within the epipolar band and the valid disparity range) are found without visiting the rest.
+// The candidates of all left features are returned as a CSR list: those of the i-th feature are
+// cand[offsets[i]] ... cand[offsets[i+1]-1], in increasing order.
+class EpipolarIndex
+{
+
+public:
+
+    EpipolarIndex();
+    ~EpipolarIndex();
+
+    // the features are referenced, not copied, and must outlive the queries
+    void setPoints( const vector<KeyPoint> &points_r, double max_dist_epip );
+    void setLines( const vector<KeyLine> &lines_r, double max_dist_epip );
+
+    void pointCandidates( const vector<KeyPoint> &points_l, double min_disp, vector<int> &offsets, vector<int> &cand ) const;
+    void lineCandidates( const vector<KeyLine> &lines_l, double min_disp, double min_horiz_angle, double max_angle_diff,
+                         vector<int> &offsets, vector<int> &cand ) const;
+
+private:
+
+    double band;                            // max. epipolar distance
+    const vector<KeyPoint> *points;
+    const vector<KeyLine>  *lines;
+    vector<vector<int>>     pt_rows;        // points of each row bucket, sorted by x
+    vector<vector<int>>     ls_rows;        // lines spanning each row bucket
+
+};
+
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/line_descriptor.hpp>
+#include <opencv2/line_descriptor/descriptor.hpp>
+using namespace cv;
+using namespace cv::line_descriptor;
+
+#include <config.h>
+#include <imagePyramid.h>
+#include <threadPool.h>
+
+namespace StVO{
+
+// Detection and description context kept alive between frames (one per image stream, i.e.
+// per worker thread), so that detectors and their internal buffers are not rebuilt every call
+class FeatureExtractor
+{
+public:
+
+    FeatureExtractor();
+    ~FeatureExtractor();
+
+    void detectFeatures(const Mat &img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length);
+
+private:
+
+    void detectPointFeatures(vector<KeyPoint> &points, Mat &pdesc);
+    void detectLineFeatures(vector<KeyLine> &lines, Mat &ldesc, double min_line_length);
+    void detectLines(vector<KeyLine> &lines, double min_line_length);
+    void describeLines(vector<KeyLine> &lines, Mat &ldesc);
+
+    ImagePyramid                            pyr;
+
+    Ptr<ORB>                                orb;
+    Ptr<BinaryDescriptor>                   lbd;
+    Ptr<LSDDetector>                        lsd;
+    Ptr<BinaryDescriptor::EDLineDetector>   edl;
+    BinaryDescriptor::LineChains            edl_chains;
+    LSDDetector::LSDOptions                 lsd_opts;
+
+};
+
+}
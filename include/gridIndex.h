@@ -0,0 +1,57 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+namespace StVO{
+
+// Uniform grid over 2D image positions, used to retrieve the features inside a gating window
+// without visiting the rest of the frame. Cells are stored as a CSR list (cell_start, items).
+class GridIndex
+{
+
+public:
+
+    GridIndex();
+    ~GridIndex();
+
+    void build( const vector<double> &xs_, const vector<double> &ys_, double cell_w_, double cell_h_ );
+
+    // appends (unsorted) the positions inside [x0,x1] x [y0,y1]
+    void query( double x0, double y0, double x1, double y1, vector<int> &idx ) const;
+
+private:
+
+    int cellCol( double x ) const;
+    int cellRow( double y ) const;
+
+    vector<double> xs, ys;
+    double x_min, y_min, cell_w, cell_h;
+    int    n_cols, n_rows;
+    vector<int> cell_start, items;
+
+};
+
+}
@@ -0,0 +1,79 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+using namespace cv;
+
+namespace StVO{
+
+// best K train descriptors of one query descriptor, closest first (trainIdx -1 at the maximum
+// distance, 8 * cols, if there is none)
+template<int K>
+struct KnnMatch
+{
+    int trainIdx[K];
+    int distance[K];
+};
+typedef KnnMatch<2> KnnMatch2;
+
+// k=2 matches of a set of query descriptors, stored contiguously and indexed by queryIdx
+typedef vector<KnnMatch2> KnnMatches;
+
+// converts the output of BFMatcher/BinaryDescriptorMatcher::knnMatch (one vector per query, any
+// order) into KnnMatches for n_query queries; queries without matches keep trainIdx -1
+void toKnnMatches( const vector<vector<DMatch>> &dmatches, int n_query, int max_dist, KnnMatches &matches );
+
+// Brute-force k=2 Hamming matcher specialized for 256-bit binary descriptors (ORB and LBD),
+// with a SIMD popcount kernel selected at runtime (AVX-512 VPOPCNTDQ, AVX2 or scalar)
+class HammingMatcher
+{
+
+public:
+
+    // true if both descriptor sets are 32-byte CV_8U rows
+    static bool supports( const Mat &desc_1, const Mat &desc_2 );
+
+    // best two matches in desc_2 of every row of desc_1
+    static void knnMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12 );
+
+    // fused cross-check: a single pass over the distance matrix gives the best two matches of every
+    // row of desc_1 and the best match of every row of desc_2 (only its first entry is filled),
+    // i.e. knnMatch( desc_1, desc_2 ) plus the best match of knnMatch( desc_2, desc_1 )
+    static void crossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 );
+
+    // fused cross-check restricted to candidate pairs, given as a CSR list: row i of desc_1 is only
+    // compared against rows cand[offsets[i]] ... cand[offsets[i+1]-1] of desc_2 (in increasing order),
+    // rows and columns without candidates have trainIdx -1
+    static void crossCheckMatch( const Mat &desc_1, const Mat &desc_2, const vector<int> &offsets, const vector<int> &cand,
+                                 KnnMatches &matches_12, KnnMatches &matches_21 );
+
+    // name of the kernel selected for this CPU
+    static const char* kernelName();
+
+};
+
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+using namespace cv;
+
+namespace StVO{
+
+// Grayscale image, smoothed Gaussian pyramid and Sobel derivatives of one input image, computed
+// once. The grayscale image is shared by ORB and the line detectors; the pyramid feeds EDLines
+// (first octave) and its derivatives the LBD descriptor. ORB still builds its own scale pyramid
+// and LSD its own gradients, since their OpenCV interfaces do not accept precomputed ones.
+class ImagePyramid
+{
+
+public:
+
+    ImagePyramid();
+    ~ImagePyramid();
+
+    // n_octaves = 0 only computes the grayscale image, gradients = false skips the derivatives
+    void compute( const Mat &img, int n_octaves = 1, int reduction_ratio = 2, bool gradients = true );
+
+    // the two stages of compute, so that the users of the grayscale image need not wait for the pyramid
+    void computeGray( const Mat &img );
+    void computeOctaves( int n_octaves = 1, int reduction_ratio = 2, bool gradients = true );
+
+    Mat         gray;           // grayscale input (8UC1)
+    vector<Mat> octaves;        // smoothed pyramid levels (5x5 Gaussian, sigma 1, as in the LBD)
+    vector<Mat> dx, dy;         // 3x3 Sobel derivatives of each level (16SC1)
+
+private:
+
+    Mat         gray_buf;       // own storage for the conversion, never aliasing the input
+
+};
+
+}
@@ -0,0 +1,92 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+using namespace cv;
+
+#include <hammingMatcher.h>
+
+namespace StVO{
+
+// interchangeable ways of cross-check matching two sets of 256-bit binary descriptors, which give
+// the same matches up to the order of equidistant descriptors
+enum MatchStrategy
+{
+    MATCH_LINEAR   = 0,     // SIMD brute force over all pairs (HammingMatcher)
+    MATCH_MIH      = 1      // multi-index hashing (BinaryDescriptorMatcher)
+};
+
+// Cost model of the matchers, fitted once to timings on synthetic descriptors (on first use) and
+// optionally cached in a YAML file (Config::matcherModelFile) so that later runs skip the calibration.
+// The cross-checks restricted to the candidates of a geometric index are not modelled, since only
+// the bucketed matcher honours the candidates and the global ones would change the matches.
+class MatcherCostModel
+{
+
+public:
+
+    static MatcherCostModel& getInstance();
+
+    // cheapest strategy to cross-check n_1 against n_2 descriptors
+    MatchStrategy select( int n_1, int n_2 ) const;
+
+    // predicted times (ms)
+    double linearCost( int n_1, int n_2 ) const;
+    double mihCost( int n_1, int n_2 ) const;
+
+    void calibrate();
+    bool load( const string &file );
+    bool save( const string &file ) const;
+
+    // cross-check with multi-index hashing, both directions built from scratch (same output as
+    // HammingMatcher::crossCheckMatch, only the first entry of matches_21 is filled)
+    static void mihCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 );
+
+    // cross-check with the cheapest strategy (linear when Config::adaptiveMatching is off), same
+    // output as HammingMatcher::crossCheckMatch
+    static void adaptiveCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 );
+
+    // cross-check restricted to the candidates, always with the bucketed HammingMatcher::crossCheckMatch
+    static void adaptiveCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, const vector<int> &offsets, const vector<int> &cand,
+                                         KnnMatches &matches_12, KnnMatches &matches_21 );
+
+private:
+
+    MatcherCostModel();
+
+    // least squares fit of t = A * coeffs (with non-negative coefficients)
+    static void fit( const vector<vector<double>> &A, const vector<double> &t, vector<double> &coeffs );
+
+    // linear: fixed + per compared pair
+    double lin_fixed, lin_pair;
+    // mih: fixed + per descriptor (index build and query of both sets)
+    double mih_fixed, mih_desc;
+
+};
+
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include <eigen3/Eigen/Core>
+using namespace Eigen;
+
+typedef Matrix<double,6,6> Matrix6d;
+typedef Matrix<double,6,1> Vector6d;
+
+namespace StVO{
+
+// Normal equations of a batch of residuals of the 6-dof pose, H = sum wh_k J_k J_k^T and
+// g = sum wg_k J_k, plus the error e = sum e_k. Residual k is written to slot k (so that slots can
+// be filled from several threads) and unset slots do not contribute. The jacobians are stored as
+// structures of arrays and summed by a SIMD kernel selected at runtime (4 residuals per step with
+// AVX2+FMA, or scalar), which only accumulates the 21 entries of the upper triangle of H and
+// mirrors them at the end. The sum goes through fixed chunks of residuals added in order, so
+// its result is the same with or without threads.
+class NormalEquations
+{
+
+public:
+
+    void clear();
+    int  size() const { return wh.size(); }
+
+    // n unset slots
+    void resize( int n );
+    void set( int k, const Vector6d &J_, double wh_, double wg_, double e_ );
+
+    // H, g, error and number of the residuals set (the chunks summed on the thread pool if parallel)
+    void sum( Matrix6d &H, Vector6d &g, double &e, int &n, bool parallel = false ) const;
+
+    // errors e_k of the residuals set, in slot order
+    void errors( vector<double> &e_ ) const;
+
+    // name of the kernel selected for this CPU
+    static const char* kernelName();
+
+    // selects the kernel by name ("scalar" or "avx2-fma"), false if this CPU does not support it;
+    // not thread-safe, meant for checking the kernels against each other
+    static bool setKernel( const char* name );
+
+private:
+
+    vector<double> J[6];        // J[i][k] is the i-th entry of the jacobian of residual k
+    vector<double> wh, wg;
+    vector<double> e;
+    vector<char>   used;
+
+};
+
+}
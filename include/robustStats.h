@@ -0,0 +1,46 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+namespace StVO{
+
+// Robust statistics computed by selection (nth_element) or by histograms for small integer
+// values, in O(n) instead of sorting. The median is the upper one (element n/2 of the sorted
+// samples), and the standard deviation is estimated as 1.4826 * MAD.
+
+// median of x, whose elements are reordered
+double medianSelect( vector<double> &x );
+float  medianSelect( float* x, int n );
+
+// standard deviation (MAD), x is overwritten with the absolute deviations from the median
+double stdvMADSelect( vector<double> &x );
+double stdvMADSelect( float* x, int n );
+
+// same for integer samples in [0,max_val] (e.g. Hamming distances), x is left untouched
+int    medianHistogram( const vector<int> &x, int max_val );
+double stdvMADHistogram( const vector<int> &x, int max_val );
+
+}
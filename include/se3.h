@@ -0,0 +1,68 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+using namespace Eigen;
+
+typedef Matrix<double,6,6> Matrix6d;
+typedef Matrix<double,6,1> Vector6d;
+
+namespace StVO{
+
+// Rigid body transformation in SE(3), stored as a fixed-size rotation and translation. The
+// tangent vectors are x = (v, w), translational part first, as in transformation_expmap and
+// logarithm_map, with exp(x) = [ exp(w^) V(w)v ; 0 1 ].
+class SE3
+{
+
+public:
+
+    SE3() : R( Matrix3d::Identity() ), t( Vector3d::Zero() ) {}
+    SE3( const Matrix3d &R_, const Vector3d &t_ ) : R( R_ ), t( t_ ) {}
+    explicit SE3( const Matrix4d &T ) : R( T.block<3,3>(0,0) ), t( T.block<3,1>(0,3) ) {}
+
+    static SE3 exp( const Vector6d &x );
+    Vector6d   log() const;
+
+    SE3 inverse() const { return SE3( R.transpose(), -( R.transpose() * t ) ); }
+    SE3 operator*( const SE3 &T ) const { return SE3( R * T.R, R * T.t + t ); }
+    Vector3d operator*( const Vector3d &P ) const { return R * P + t; }
+
+    const Matrix3d& rotation() const    { return R; }
+    const Vector3d& translation() const { return t; }
+    Matrix4d matrix() const;
+    bool isFinite() const { return R.allFinite() && t.allFinite(); }
+
+    // jacobians of exp, exp(x+dx) ~ exp(Jl(x) dx) exp(x) ~ exp(x) exp(Jr(x) dx)
+    static Matrix6d leftJacobian( const Vector6d &x );
+    static Matrix6d rightJacobian( const Vector6d &x ) { return leftJacobian( -x ); }
+
+private:
+
+    Matrix3d R;
+    Vector3d t;
+
+};
+
+}
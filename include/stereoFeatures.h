@@ -19,56 +19,110 @@
 **																			**
 *****************************************************************************/
 
+
 #pragma once
+
+#include <vector>
+using namespace std;
+
 #include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/StdVector>
 using namespace Eigen;
 
 namespace StVO{
 
-class PointFeature
+typedef vector<Vector2d, aligned_allocator<Vector2d> > Vector2dArray;
+typedef vector<Vector3d, aligned_allocator<Vector3d> > Vector3dArray;
+typedef vector<Matrix3d, aligned_allocator<Matrix3d> > Matrix3dArray;
+
+// covariance of the back-projection of pixel pl with disparity disp, up to the scale f*b*sigma_px
+// (the pixel noise) applied in the optimization
+Matrix3d backProjectionCov( const Vector2d &pl, double disp, double f, double cx, double cy );
+
+// Stereo point features of a frame as a structure of arrays (feature i is the i-th entry of each one)
+class PointFeatures
+{
+
+public:
+
+    int  size() const  { return pl.size(); }
+    bool empty() const { return pl.empty(); }
+    void clear();
+    void push_back( const Vector2d &pl_, double disp_, const Vector3d &P_, int idx_ );
+
+    vector<int>    idx;         // track index (-1 until assigned)
+    Vector2dArray  pl;          // position in the left image
+    vector<double> disp;        // disparity
+    Vector3dArray  P;           // 3D point in the camera frame
+
+};
+
+// Stereo line segment features of a frame as a structure of arrays
+class LineFeatures
 {
 
 public:
 
-    PointFeature( Vector2d pl_, double disp_, Vector3d P_ );
-    PointFeature( Vector2d pl_, double disp_, Vector3d P_, int idx_ );
-    PointFeature( Vector2d pl_, double disp_, Vector3d P_, Vector2d pl_obs_ );
-    ~PointFeature(){};
+    int  size() const  { return spl.size(); }
+    bool empty() const { return spl.empty(); }
+    void clear();
+    void push_back( const Vector2d &spl_, double sdisp_, const Vector3d &sP_,
+                    const Vector2d &epl_, double edisp_, const Vector3d &eP_,
+                    const Vector3d &le_,  double angle_, int idx_ );
 
-    int idx;
-    Vector2d pl, pl_obs;
-    double   disp;
-    Vector3d P;
-    bool inlier;
+    vector<int>    idx;         // track index (-1 until assigned)
+    Vector2dArray  spl, epl;    // endpoints in the left image
+    vector<double> sdisp, edisp;
+    Vector3dArray  sP, eP;      // 3D endpoints in the camera frame
+    Vector3dArray  le;          // normalized line equation in the left image
+    vector<double> angle;
 
 };
 
-class LineFeature
+// Frame-to-frame point matches: feature prev[i] of the previous frame is observed as feature curr[i]
+// of the current one. The data used by the pose optimization is copied from both frames when the
+// match is added, so that each iteration streams through contiguous arrays.
+class PointMatches
 {
 
 public:
 
-    LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                 Vector2d epl_, double edisp_, Vector3d eP_,
-                 Vector3d le_,  int idx_);
-    LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                 Vector2d epl_, double edisp_, Vector3d eP_,
-                 Vector3d le_,  double angle_, int idx_);
-
-
-    LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                 Vector2d epl_, double edisp_, Vector3d eP_, Vector3d le_);
-    LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                 Vector2d epl_, double edisp_, Vector3d eP_,
-                 Vector3d le_, Vector3d le_obs_);
-    ~LineFeature(){};
-
-    int idx;
-    Vector2d spl,epl, spl_obs, epl_obs;
-    double   sdisp, edisp, angle;
-    Vector3d sP,eP;
-    Vector3d le, le_obs;
-    bool inlier;
+    int  size() const  { return prev.size(); }
+    bool empty() const { return prev.empty(); }
+    void clear();
+    void push_back( const PointFeatures &f_prev, int i_prev, const PointFeatures &f_curr, int i_curr );
+    void computeCovariances( double f, double cx, double cy );
+
+    vector<int>    prev, curr;  // indices in the previous and current frames
+    Vector3dArray  P;           // 3D point (previous frame)
+    Vector2dArray  pl;          // position in the previous frame
+    vector<double> disp;        // disparity in the previous frame
+    Vector2dArray  pl_obs;      // observation in the current frame
+    vector<char>   inlier;
+    Matrix3dArray  covP;        // back-projection covariance of P (after computeCovariances)
+
+};
+
+// Frame-to-frame line segment matches, laid out as PointMatches
+class LineMatches
+{
+
+public:
+
+    int  size() const  { return prev.size(); }
+    bool empty() const { return prev.empty(); }
+    void clear();
+    void push_back( const LineFeatures &f_prev, int i_prev, const LineFeatures &f_curr, int i_curr );
+    void computeCovariances( double f, double cx, double cy );
+
+    vector<int>    prev, curr;
+    Vector3dArray  sP, eP;      // 3D endpoints (previous frame)
+    Vector2dArray  spl, epl;    // endpoints in the previous frame
+    vector<double> sdisp, edisp;
+    Vector2dArray  spl_obs, epl_obs;    // endpoints observed in the current frame
+    Vector3dArray  le_obs;      // line equation observed in the current frame
+    vector<char>   inlier;
+    Matrix3dArray  covS, covE;  // back-projection covariances of sP and eP (after computeCovariances)
 
 };
 
@@ -37,7 +37,14 @@ using namespace cv::line_descriptor;
 using namespace Eigen;
 
 #include <config.h>
+#include <featureExtractor.h>
+#include <hammingMatcher.h>
+#include <matcherCostModel.h>
+#include <epipolarIndex.h>
+#include <robustStats.h>
+#include <threadPool.h>
 #include <stereoFeatures.h>
+#include <se3.h>
 #include <pinholeStereoCamera.h>
 #include <auxiliar.h>
 
@@ -52,31 +59,48 @@ public:
 
     StereoFrame();
     StereoFrame(const Mat img_l_, const Mat img_r_, const int idx_, PinholeStereoCamera* cam_ );
+    StereoFrame(const Mat img_l_, const Mat img_r_, const int idx_, PinholeStereoCamera* cam_, FeatureExtractor* fext_l_, FeatureExtractor* fext_r_ );
     ~StereoFrame();
 
+    void reset(const Mat img_l_, const Mat img_r_, const int idx_);
+
     void extractStereoFeatures();
     void extractInitialStereoFeatures();
-    void detectFeatures(Mat img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length);
-    void matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, vector<vector<DMatch>> &pmatches_12);
-    void matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, vector<vector<DMatch>> &lmatches_12 );
-    void pointDescriptorMAD( const vector<vector<DMatch>> matches, double &nn_mad, double &nn12_mad );
-    void lineDescriptorMAD( const vector<vector<DMatch>> matches, double &nn_mad, double &nn12_mad );
+    void detectFeatures(FeatureExtractor* fext, Mat img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length);
+    void matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12);
+    void matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, KnnMatches &lmatches_12 );
+    void pointDescriptorMAD( const KnnMatches &matches, double &nn_mad, double &nn12_mad );
+    void lineDescriptorMAD( const KnnMatches &matches, double &nn_mad, double &nn12_mad );
+    Ptr<BinaryDescriptorMatcher> lineIndex();
 
     int frame_idx;
     Mat img_l, img_r;
-    Matrix4d Tfw;
-    Matrix4d DT;
+    SE3      Tfw;
+    SE3      DT;
     Matrix6d DT_cov;
     Vector6d DT_cov_eig;
     double   err_norm;
 
-    vector<PointFeature*> stereo_pt;
-    vector<LineFeature*>  stereo_ls;
+    PointFeatures stereo_pt;
+    LineFeatures  stereo_ls;
 
     Mat pdesc_l, pdesc_r, ldesc_l, ldesc_r;
 
     PinholeStereoCamera* cam;
 
+private:
+
+    void initMotion();
+    void setupExtractors();
+    void matchPointsInBand( const vector<KeyPoint> &points_l, const vector<KeyPoint> &points_r, KnnMatches &pmatches_lr, KnnMatches &pmatches_rl );
+    void matchLinesInBand( const vector<KeyLine> &lines_l, const vector<KeyLine> &lines_r, KnnMatches &lmatches_lr, KnnMatches &lmatches_rl );
+
+    FeatureExtractor *fext_l, *fext_r;
+    bool own_fext;
+
+    Ptr<BinaryDescriptorMatcher> ldesc_l_index;     // line descriptors index for the f2f matching
+    bool ldesc_l_indexed;
+
 };
 
 }
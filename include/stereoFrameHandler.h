@@ -20,8 +20,11 @@
 *****************************************************************************/
 
 #pragma once
+#include <deque>
 #include <stereoFrame.h>
 #include <stereoFeatures.h>
+#include <gridIndex.h>
+#include <normalEquations.h>
 
 typedef Matrix<double,6,6> Matrix6d;
 typedef Matrix<double,6,1> Vector6d;
@@ -30,6 +33,17 @@ class StereoFrame;
 
 namespace StVO{
 
+// robust kernels of the non-weighted cost function, as weights of the squared residual
+struct SquaredLoss
+{
+    static double weight( double r2 ) { return 1.0; }
+};
+
+struct CauchyLoss
+{
+    static double weight( double r2 ) { return 1.0 / ( 1.0 + r2 ); }
+};
+
 class StereoFrameHandler
 {
 
@@ -40,16 +54,17 @@ public:
 
     void initialize( const Mat img_l_, const Mat img_r_, const int idx_);
     void insertStereoPair(const Mat img_l_, const Mat img_r_, const int idx_);
+    bool prefetchStereoPair(const Mat img_l_, const Mat img_r_, const int idx_);
     void f2fTracking();
     void optimizePose();
-    void optimizePose(Matrix4d DT_ini);
+    void optimizePose(const SE3 &DT_ini);
     void updateFrame();
     void setMotionPrior(Vector6d prior_inc_, Matrix6d prior_cov_);
 
     int  n_inliers, n_inliers_pt, n_inliers_ls, max_idx_pt, max_idx_ls, max_idx_pt_prev_kf, max_idx_ls_prev_kf;
 
-    list<PointFeature*> matched_pt;
-    list<LineFeature*>  matched_ls;
+    PointMatches matched_pt;
+    LineMatches  matched_ls;
 
     StereoFrame* prev_keyframe;
     StereoFrame* prev_frame;
@@ -61,13 +76,37 @@ public:
 
 private:
 
-    void matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, vector<vector<DMatch>> &pmatches_12  );
-    void matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, vector<vector<DMatch>> &lmatches_12  );
-    void removeOutliers( Matrix4d DT );
-    void gaussNewtonOptimization(Matrix4d &DT, Matrix6d &DT_cov, double &err_, int max_iters);
-    void levMarquardtOptimization(Matrix4d &DT, Matrix6d &DT_cov, double &err_, int max_iters);
-    void optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H, Vector6d &g, double &e);
-    void optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H, Vector6d &g, double &e);
+    struct PendingFrame
+    {
+        StereoFrame* frame;
+        future<void> extraction;
+    };
+
+    vector<StereoFrame*> frame_ring;
+    deque<PendingFrame>  pending_frames;    // prefetched pairs, at most Config::pipelineDepth()
+    StereoFrame* nextFrame(const Mat img_l_, const Mat img_r_, const int idx_);
+    void drainPendingFrames();
+
+    void matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12  );
+    void matchLineFeatures(Mat ldesc_1, StereoFrame* frame_2, KnnMatches &lmatches_12  );
+    void matchPointsInWindow( Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12, KnnMatches &pmatches_21 );
+    void matchLinesInWindow( Mat ldesc_1, Mat ldesc_2, KnnMatches &lmatches_12, KnnMatches &lmatches_21 );
+    bool hasMotionPrediction();
+    bool predictProjection( const SE3 &DT_pred, const Vector3d &P, Vector2d &pl_pred, Vector2d &win );
+    void removeOutliers( const SE3 &DT );
+    void gaussNewtonOptimization(SE3 &DT, Matrix6d &DT_cov, double &err_, int max_iters);
+    void levMarquardtOptimization(SE3 &DT, Matrix6d &DT_cov, double &err_, int max_iters);
+    template<class Kernel, bool Points, bool Lines, bool Scale>
+    void optimizeFunctions_nonweighted(const SE3 &DT, Matrix6d &H, Vector6d &g, double &e);
+    void optimizeFunctions_uncweighted(const SE3 &DT, Matrix6d &H, Vector6d &g, double &e);
+
+    // hessian, gradient and error of the pose, chosen once per optimizePose from the Config flags
+    typedef void (StereoFrameHandler::*CostFunction)(const SE3 &DT, Matrix6d &H, Vector6d &g, double &e);
+    CostFunction cost_function;
+    NormalEquations neq_p, neq_l;   // per-feature jacobians and weights of the current iteration
+    void selectCostFunction();
+    template<class Kernel>
+    CostFunction nonweightedCostFunction( bool points, bool lines, bool scale );
 
 };
 
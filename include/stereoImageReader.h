@@ -0,0 +1,81 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <opencv/cv.h>
+#include <opencv2/highgui/highgui.hpp>
+using namespace cv;
+
+#include <threadPool.h>
+
+namespace StVO{
+
+// Sequential reader of a list of stereo pairs. The next n_prefetch pairs are decoded on the thread
+// pool (straight to grayscale by default, as the detectors convert anyway) into a ring of slots,
+// so that decoding overlaps with the processing of the current pair.
+class StereoImageReader
+{
+
+public:
+
+    StereoImageReader( const vector<string> &files_l_, const vector<string> &files_r_, int n_prefetch = 4, int flags_ = IMREAD_GRAYSCALE );
+    ~StereoImageReader();
+
+    // next pair of the sequence, false at the end or if one of the images could not be read
+    // (the reader then stops, see failed())
+    bool next( Mat &img_l, Mat &img_r );
+
+    int size() const { return files_l.size(); }
+
+    // whether the sequence was cut by an image that could not be read, and its index and path
+    bool failed() const { return failed_idx >= 0; }
+    int failedIndex() const { return failed_idx; }
+    const string& failedFile() const { return failed_file; }
+
+private:
+
+    struct Slot
+    {
+        Mat img_l, img_r;
+        future<void> decoded_l, decoded_r;
+    };
+
+    static void decode( const string &file, int flags, Mat &img );
+    void request( int i );
+
+    vector<string> files_l, files_r;
+    vector<Slot>   ring;
+    int flags;
+    int n_read;         // pairs returned by next()
+    int n_requested;    // pairs submitted for decoding
+    int failed_idx;     // pair that could not be read, -1 if none
+    string failed_file;
+
+};
+
+}
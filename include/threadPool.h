@@ -0,0 +1,152 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+namespace StVO{
+
+// Process-wide pool of worker threads (Config::poolThreads, optionally pinned to cores with
+// Config::poolPinning). Each worker owns a task deque: it runs its own tasks newest first and steals
+// the oldest ones from the other workers when idle. Tasks belong to the group of the thread that
+// submitted them, except for the background ones (e.g. the extraction of a prefetched frame), which
+// start a new group inherited by their subtasks. Waiting on a task runs the pending tasks of the
+// waiter's own group in the meantime, so tasks may submit and wait for subtasks, while long-lived
+// background work is left to the workers.
+class ThreadPool
+{
+
+public:
+
+    static ThreadPool& getInstance();
+    ~ThreadPool();
+
+    int numWorkers() const { return workers.size(); }
+
+    // runs f(args...) on the pool (same arguments as std::async)
+    template<class F, class... Args>
+    future<typename result_of<F(Args...)>::type> submit( F&& f, Args&&... args )
+    {
+        return submitToGroup( currentGroup(), forward<F>(f), forward<Args>(args)... );
+    }
+
+    // same, in a new group that is never run by the threads waiting on other groups
+    template<class F, class... Args>
+    future<typename result_of<F(Args...)>::type> submitBackground( F&& f, Args&&... args )
+    {
+        return submitToGroup( next_group++, forward<F>(f), forward<Args>(args)... );
+    }
+
+    // runs body(i) for every i in [0,n), split in contiguous ranges of at least grain indices, the
+    // calling thread taking the first one
+    template<class Body>
+    void parallelFor( int n, int grain, const Body &body )
+    {
+        int n_ranges = std::min( ( n + grain - 1 ) / std::max( 1, grain ), 4 * ( numWorkers() + 1 ) );
+        if( n_ranges <= 1 )
+        {
+            for( int i = 0; i < n; i++ )
+                body( i );
+            return;
+        }
+        vector<future<void> > tasks;
+        for( int r = 1; r < n_ranges; r++ )
+        {
+            int first = (long long) r * n / n_ranges, last = (long long) (r+1) * n / n_ranges;
+            tasks.push_back( submit( [&body,first,last](){ for( int i = first; i < last; i++ ) body( i ); } ) );
+        }
+        for( int i = 0; i < (long long) n / n_ranges; i++ )
+            body( i );
+        for( int r = 0; r < tasks.size(); r++ )
+            wait( tasks[r] );
+    }
+
+    // blocks until fut is ready, running pending tasks of the caller's group while waiting
+    template<class T>
+    void wait( future<T> &fut )
+    {
+        int group = currentGroup();
+        while( fut.wait_for( chrono::seconds(0) ) != future_status::ready )
+        {
+            if( !runPendingTask( group ) )
+                fut.wait_for( chrono::microseconds(100) );
+        }
+    }
+
+private:
+
+    ThreadPool();
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    struct Task
+    {
+        function<void()> run;
+        int group;
+    };
+
+    struct WorkQueue
+    {
+        mutex m;
+        deque<Task> tasks;
+    };
+
+    template<class F, class... Args>
+    future<typename result_of<F(Args...)>::type> submitToGroup( int group, F&& f, Args&&... args )
+    {
+        typedef typename result_of<F(Args...)>::type R;
+        shared_ptr<packaged_task<R()> > task = make_shared<packaged_task<R()> >( bind( forward<F>(f), forward<Args>(args)... ) );
+        future<R> fut = task->get_future();
+        push( [task](){ (*task)(); }, group );
+        return fut;
+    }
+
+    static int currentGroup();
+    void push( function<void()> task, int group );
+    bool runPendingTask( int group );
+    bool popTask( int w, int group, Task &task );
+    void workerLoop( int w );
+
+    vector<thread> workers;
+    vector<unique_ptr<WorkQueue> > queues;
+    atomic<int>  pending;       // tasks queued and not yet taken
+    atomic<int>  next_queue;    // round robin over the queues for tasks submitted from outside the pool
+    atomic<int>  next_group;    // group of the next background task (0 is the threads outside the pool)
+    atomic<bool> stop;
+    mutex sleep_m;
+    condition_variable sleep_cv;
+
+};
+
+}
@@ -20,22 +20,17 @@
 *****************************************************************************/
 
 #include <auxiliar.h>
+#include <robustStats.h>
 
 #define PI std::acos(-1.0)
 
 /* Kinematics functions */
 
-Matrix4d inverse_transformation(Matrix4d T){
-    Matrix4d T_inv = Matrix4d::Identity();
-    Matrix3d R;
-    Vector3d t;
-    t << T(0,3), T(1,3), T(2,3);
-    R << T.block(0,0,3,3);
-    T_inv.block(0,0,3,4) << R.transpose(), -R.transpose() * t;
-    return T_inv;
+Matrix4d inverse_transformation(const Matrix4d &T){
+    return StVO::SE3(T).inverse().matrix();
 }
 
-Matrix3d skew(Vector3d v){
+Matrix3d skew(const Vector3d &v){
 
     Matrix3d skew;
 
@@ -52,7 +47,7 @@ Matrix3d skew(Vector3d v){
     return skew;
 }
 
-Matrix3d fast_skewexp(Vector3d v){
+Matrix3d fast_skewexp(const Vector3d &v){
     Matrix3d M, s, I = Matrix3d::Identity();
     double theta = v.norm();
     if(theta==0.f)
@@ -64,13 +59,13 @@ Matrix3d fast_skewexp(Vector3d v){
     return M;
 }
 
-Vector3d skewcoords(Matrix3d M){
+Vector3d skewcoords(const Matrix3d &M){
     Vector3d skew;
     skew << M(2,1), M(0,2), M(1,0);
     return skew;
 }
 
-Matrix3d skewlog(Matrix3d M){
+Matrix3d skewlog(const Matrix3d &M){
     Matrix3d skew;
     double val = (M.trace() - 1.f)/2.f;
     if(val > 1.f)
@@ -94,11 +89,9 @@ MatrixXd kroen_product(MatrixXd A, MatrixXd B){
     return AB;
 }
 
-Matrix3d v_logmap(VectorXd x){
-    Vector3d w;
+Matrix3d v_logmap(const Vector3d &w){
     double theta, theta2, theta3;
     Matrix3d W, I, V;
-    w << x(0), x(1), x(2);
     theta = w.norm();   theta2 = theta*theta; theta3 = theta2*theta;
     W = skew(w);
     I << 1, 0, 0, 0, 1, 0, 0, 0, 1;
@@ -117,61 +110,22 @@ MatrixXd diagonalMatrix(MatrixXd M, unsigned int N){
     return A;
 }
 
-Matrix4d transformation_expmap(VectorXd x){
-    Matrix3d R, V, s, I = Matrix3d::Identity();
-    Vector3d t, w;
-    Matrix4d T = Matrix4d::Identity();
-    t << x(0), x(1), x(2);
-    w << x(3), x(4), x(5);
-    double theta = w.norm();
-    if(theta==0.0f)
-        R = I;
-    else{
-        s = skew(w)/theta;
-        R << I + s * sin(theta) + s * s * (1.0f-cos(theta));
-        V << I + s * (1.0f - cos(theta)) / theta + s * s * (theta - sin(theta)) / theta;
-        t << V * t;
-    }
-    T.block(0,0,3,4) << R, t;
-    return T;
+Matrix4d transformation_expmap(const Vector6d &x){
+    return StVO::SE3::exp(x).matrix();
 }
 
-VectorXd logarithm_map(Matrix4d T){
-    Matrix3d R, Id3 = Matrix3d::Identity();
-    Vector3d Vt, t, w;
-    Matrix3d V = Matrix3d::Identity(), w_hat = Matrix3d::Zero();
-    VectorXd x(6);
-    Vt << T(0,3), T(1,3), T(2,3);
-    w << 0.f, 0.f, 0.f;
-    R = T.block(0,0,3,3);
-    double val = (R.trace() - 1.f)/2.f;
-    if(val > 1.f)
-        val = 1.f;
-    else if (val < -1.f)
-        val = -1.f;
-    double theta  = acos(val);
-    double seno   = sin(theta);
-    double coseno = cos(theta);
-    if(theta != 0.f){
-        w_hat << (R-R.transpose())/(2.f*seno)*theta;
-        w << -w_hat(1,2), w_hat(0,2), -w_hat(0,1);
-        Matrix3d s;
-        s << skew(w) / theta;
-        V << Id3 + s * (1.f-coseno) / theta + s * s * (theta - seno) / theta;
-    }
-    t = V.inverse() * Vt;
-    x << t, w;
-    return x;
+Vector6d logarithm_map(const Matrix4d &T){
+    return StVO::SE3(T).log();
 }
 
-Matrix4d transformation_expmap_approximate(VectorXd x){
+Matrix4d transformation_expmap_approximate(const Vector6d &x){
     Matrix4d T = Matrix4d::Identity();
     T << 1.f, -x(5), x(4), x(0), x(5), 1.f, -x(3), x(1), -x(4), x(3), 1.f, x(2), 0.f, 0.f, 0.f, 1.f;
     return T;
 }
 
-VectorXd logarithm_map_approximate(Matrix4d T){
-    VectorXd x(6);
+Vector6d logarithm_map_approximate(const Matrix4d &T){
+    Vector6d x;
     x(0) = T(0,3);
     x(1) = T(1,3);
     x(2) = T(2,3);
@@ -181,7 +135,7 @@ VectorXd logarithm_map_approximate(Matrix4d T){
     return x;
 }
 
-double diffManifoldError(Matrix4d T1, Matrix4d T2){
+double diffManifoldError(const Matrix4d &T1, const Matrix4d &T2){
     return ( logarithm_map(T1)-logarithm_map(T2) ).norm();
 }
 
@@ -222,29 +176,11 @@ double angDiff_d(double alpha, double beta){
 double vector_stdv_mad( VectorXf residues)
 {
     // Return the standard deviation of vector with MAD estimation
-    int n_samples = residues.size();
-    sort( residues.derived().data(),residues.derived().data()+residues.size());
-    double median = residues( n_samples/2 );
-    residues << ( residues - VectorXf::Constant(n_samples,median) ).cwiseAbs();
-    sort(residues.derived().data(),residues.derived().data()+residues.size());
-    double MAD = residues( n_samples/2 );
-    return 1.4826 * MAD;
+    return StVO::stdvMADSelect( residues.data(), residues.size() );
 }
 
 double vector_stdv_mad( vector<double> residues)
 {
-    if( residues.size() != 0 )
-    {
-        // Return the standard deviation of vector with MAD estimation
-        int n_samples = residues.size();
-        sort( residues.begin(),residues.end() );
-        double median = residues[ n_samples/2 ];
-        for( int i = 0; i < n_samples; i++)
-            residues[i] = fabsf( residues[i] - median );
-        sort( residues.begin(),residues.end() );
-        double MAD = residues[ n_samples/2 ];
-        return 1.4826 * MAD;
-    }
-    else
-        return 0.0;
+    // Return the standard deviation of vector with MAD estimation
+    return StVO::stdvMADSelect( residues );
 }
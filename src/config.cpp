@@ -38,6 +38,16 @@ Config::Config()
     scale_points_lines = true;      // true if scaling the influence of P and LS in the optimization
     use_uncertainty    = false;     // true if employing Gaussian uncertainty propagation
     motion_prior       = false;     // true if optimizing with prior information about the motion (i.e. IMU)
+    simd_matching      = true;      // true if matching 256-bit descriptors with the SIMD Hamming matcher
+    epipolar_search    = true;      // true if only comparing stereo candidates within the epipolar band (if simd_matching)
+    f2f_grid_search    = true;      // true if only comparing f2f candidates within the gating window (if simd_matching)
+    guided_matching    = false;     // true if searching f2f matches around their projection with the predicted motion (if f2f_grid_search)
+    adaptive_matching  = true;      // true if choosing the unrestricted matcher (linear or MIH) with the calibrated cost model (if simd_matching)
+    matcher_model_file = "";        // file caching the calibration of the matchers' cost model (empty to calibrate on every run)
+    pool_threads       = 0;         // number of worker threads running the parallel tasks (0 for one per core)
+    pool_pinning       = false;     // true if pinning each worker thread to a core
+    pipeline_depth     = 1;         // max. number of stereo pairs whose features are extracted ahead of the tracking (0 to disable)
+    parallel_cost_th   = 1000;      // min. number of matched points (or lines) to evaluate the cost function on the thread pool
 
     // Tracking parameters
     // -----------------------------------------------------------------------------------------------------
@@ -47,6 +57,8 @@ Config::Config()
     min_disp         = 1.0;         // min. disparity
     min_ratio_12_p   = 0.1;         // min. ratio between the first and second best matches
     max_f2f_disp     = 0.2;         // max. frame-to-frame disparity (relative to img size)
+    guided_win_k     = 3.0;         // guided matching window in standard deviations of the predicted projection
+    guided_min_win   = 10.0;        // min. half size of the guided matching window (pixels)
 
     // Line segment features
     min_line_length  = 0.015;       // min. line length (relative to img size)
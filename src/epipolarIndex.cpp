@@ -0,0 +1,167 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <epipolarIndex.h>
+#include <auxiliar.h>
+
+#include <algorithm>
+
+namespace StVO{
+
+// height (pixels) of the row buckets for line segments, which are inserted in every bucket they span
+static const double LS_BUCKET_H = 16.0;
+
+struct sort_points_by_x
+{
+    const vector<KeyPoint> &points;
+    sort_points_by_x( const vector<KeyPoint> &points_ ) : points(points_) {}
+    inline bool operator()( int a, int b ) const {
+        return ( points[a].pt.x < points[b].pt.x );
+    }
+};
+
+EpipolarIndex::EpipolarIndex() : band(1.0), points(NULL), lines(NULL) {}
+
+EpipolarIndex::~EpipolarIndex(){}
+
+void EpipolarIndex::setPoints( const vector<KeyPoint> &points_r, double max_dist_epip )
+{
+
+    // buckets of one band height, so that a query visits at most three of them
+    band   = max_dist_epip;
+    points = &points_r;
+    double h = std::max( band, 1.0 );
+    pt_rows.clear();
+    for( int j = 0; j < points_r.size(); j++ )
+    {
+        int b = std::max( 0, int( points_r[j].pt.y / h ) );
+        if( b >= pt_rows.size() )
+            pt_rows.resize( b+1 );
+        pt_rows[b].push_back( j );
+    }
+    for( int b = 0; b < pt_rows.size(); b++ )
+        sort( pt_rows[b].begin(), pt_rows[b].end(), sort_points_by_x(points_r) );
+
+}
+
+void EpipolarIndex::setLines( const vector<KeyLine> &lines_r, double max_dist_epip )
+{
+
+    band  = max_dist_epip;
+    lines = &lines_r;
+    ls_rows.clear();
+    for( int j = 0; j < lines_r.size(); j++ )
+    {
+        double y0 = std::min( lines_r[j].startPointY, lines_r[j].endPointY ) - band;
+        double y1 = std::max( lines_r[j].startPointY, lines_r[j].endPointY ) + band;
+        int b0 = std::max( 0, int( y0 / LS_BUCKET_H ) );
+        int b1 = std::max( 0, int( y1 / LS_BUCKET_H ) );
+        if( b1 >= ls_rows.size() )
+            ls_rows.resize( b1+1 );
+        for( int b = b0; b <= b1; b++ )
+            ls_rows[b].push_back( j );
+    }
+
+}
+
+void EpipolarIndex::pointCandidates( const vector<KeyPoint> &points_l, double min_disp, vector<int> &offsets, vector<int> &cand ) const
+{
+
+    offsets.resize( points_l.size() + 1 );
+    cand.clear();
+    offsets[0] = 0;
+    double h = std::max( band, 1.0 );
+    for( int i = 0; i < points_l.size(); i++ )
+    {
+        double x = points_l[i].pt.x, y = points_l[i].pt.y;
+        int b0 = std::max( 0, int( (y - band) / h ) );
+        int b1 = std::min( int(pt_rows.size()) - 1, int( (y + band) / h ) );
+        int first = cand.size();
+        for( int b = b0; b <= b1; b++ )
+        {
+            // sorted by x: the disparity decreases along the bucket
+            for( int k = 0; k < pt_rows[b].size(); k++ )
+            {
+                const KeyPoint &p = (*points)[ pt_rows[b][k] ];
+                if( x - p.pt.x < min_disp )
+                    break;
+                if( fabs( p.pt.y - y ) <= band )
+                    cand.push_back( pt_rows[b][k] );
+            }
+        }
+        sort( cand.begin() + first, cand.end() );
+        offsets[i+1] = cand.size();
+    }
+
+}
+
+void EpipolarIndex::lineCandidates( const vector<KeyLine> &lines_l, double min_disp, double min_horiz_angle, double max_angle_diff,
+                                    vector<int> &offsets, vector<int> &cand ) const
+{
+
+    offsets.resize( lines_l.size() + 1 );
+    cand.clear();
+    offsets[0] = 0;
+    vector<int> visited( lines->size(), -1 );
+    for( int i = 0; i < lines_l.size(); i++ )
+    {
+        const KeyLine &l = lines_l[i];
+        int first = cand.size();
+        if( fabs(l.angle) >= min_horiz_angle )
+        {
+            double y0 = std::min( l.startPointY, l.endPointY );
+            double y1 = std::max( l.startPointY, l.endPointY );
+            int b0 = std::max( 0, int( y0 / LS_BUCKET_H ) );
+            int b1 = std::min( int(ls_rows.size()) - 1, int( y1 / LS_BUCKET_H ) );
+            for( int b = b0; b <= b1; b++ )
+            {
+                for( int k = 0; k < ls_rows[b].size(); k++ )
+                {
+                    int j = ls_rows[b][k];
+                    if( visited[j] == i )
+                        continue;
+                    visited[j] = i;
+                    // same angular checks as the stereo matching
+                    const KeyLine &r = (*lines)[j];
+                    if( fabs(r.angle) < min_horiz_angle || fabs( angDiff( l.angle, r.angle ) ) >= max_angle_diff )
+                        continue;
+                    // overlapping rows, within the epipolar band
+                    if( std::max( r.startPointY, r.endPointY ) + band < y0 || std::min( r.startPointY, r.endPointY ) - band > y1 )
+                        continue;
+                    // disparity of both endpoints, intersecting the right line with their rows
+                    double a  = r.endPointY - r.startPointY;
+                    if( a == 0.0 )
+                        continue;
+                    double xs = r.startPointX + ( l.startPointY - r.startPointY ) * ( r.endPointX - r.startPointX ) / a;
+                    double xe = r.startPointX + ( l.endPointY   - r.startPointY ) * ( r.endPointX - r.startPointX ) / a;
+                    if( l.startPointX - xs >= min_disp && l.endPointX - xe >= min_disp )
+                        cand.push_back( j );
+                }
+            }
+        }
+        sort( cand.begin() + first, cand.end() );
+        offsets[i+1] = cand.size();
+    }
+
+}
+
+}
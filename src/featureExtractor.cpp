@@ -0,0 +1,178 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <featureExtractor.h>
+
+namespace StVO{
+
+FeatureExtractor::FeatureExtractor()
+{
+    orb = ORB::create( Config::orbNFeatures(), Config::orbScaleFactor(), Config::orbNLevels() );
+    lbd = BinaryDescriptor::createBinaryDescriptor();
+}
+
+FeatureExtractor::~FeatureExtractor(){}
+
+void FeatureExtractor::detectFeatures(const Mat &img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length)
+{
+
+    // Grayscale image, and smoothed pyramid only if LBD descriptors are needed (the EDLines
+    // detector computes the gradients of the smoothed image itself, so they are not repeated)
+    int  n_octaves = Config::hasLines() ? 1 : 0;
+    bool gradients = !Config::useEDLines();
+    lines.clear();
+    if( !Config::lrInParallel() )
+    {
+        pyr.compute( img, n_octaves, 2, gradients );
+        if( Config::hasPoints() )
+            detectPointFeatures( points, pdesc );
+        if( Config::hasLines() )
+            detectLineFeatures( lines, ldesc, min_line_length );
+        return;
+    }
+
+    // Task graph on the pool: gray -> { ORB, pyramid, LSD }, { pyramid, LSD } -> LBD (the EDLines
+    // detector runs on the smoothed image, so in that case the line chain is sequential)
+    ThreadPool &pool = ThreadPool::getInstance();
+    pyr.computeGray( img );
+    future<void> points_task;
+    if( Config::hasPoints() )
+        points_task = pool.submit( &FeatureExtractor::detectPointFeatures, this, ref(points), ref(pdesc) );
+    if( Config::hasLines() )
+    {
+        if( Config::useEDLines() )
+        {
+            pyr.computeOctaves( n_octaves, 2, gradients );
+            detectLineFeatures( lines, ldesc, min_line_length );
+        }
+        else
+        {
+            auto pyr_task = pool.submit( &ImagePyramid::computeOctaves, &pyr, n_octaves, 2, gradients );
+            detectLines( lines, min_line_length );
+            pool.wait( pyr_task );
+            describeLines( lines, ldesc );
+        }
+    }
+    else
+        pyr.computeOctaves( n_octaves, 2, gradients );
+    if( points_task.valid() )
+        pool.wait( points_task );
+
+}
+
+void FeatureExtractor::detectPointFeatures(vector<KeyPoint> &points, Mat &pdesc)
+{
+    orb->detectAndCompute( pyr.gray, Mat(), points, pdesc, false);
+}
+
+void FeatureExtractor::detectLineFeatures(vector<KeyLine> &lines, Mat &ldesc, double min_line_length)
+{
+    detectLines( lines, min_line_length );
+    describeLines( lines, ldesc );
+}
+
+void FeatureExtractor::detectLines(vector<KeyLine> &lines, double min_line_length)
+{
+
+    if( Config::useEDLines() )
+    {
+        // the EDLines detector is created on first use and kept for the following frames
+        if( !edl )
+        {
+            BinaryDescriptor::EDLineParam opts;
+            opts.ksize               = Config::edlKsize();
+            opts.sigma               = Config::edlSigma();
+            opts.gradientThreshold   = Config::edlGradientTh();
+            opts.anchorThreshold     = Config::edlAnchorTh();
+            opts.scanIntervals       = Config::edlScanInterv();
+            opts.minLineLen          = Config::edlMinLineLen();
+            opts.lineFitErrThreshold = Config::edlFitErrTh();
+            edl = makePtr<BinaryDescriptor::EDLineDetector>(opts);
+        }
+        // run on the smoothed image so that its gradients are the ones expected by the LBD
+        Mat img_ = pyr.octaves[0];
+        edl->EDline(img_,edl_chains);
+        int idx_aux = 0;
+        for(int i = 0; i < edl->lineEndpoints_.size(); i++)
+        {
+            KeyLine l_;
+            // estimate endpoints from LineChains
+            int s_idx = edl_chains.sId[i];
+            int e_idx = edl_chains.sId[i+1] - 1;
+            float sx  = edl->lineEndpoints_[i][0];
+            float sy  = edl->lineEndpoints_[i][1];
+            float ex  = edl->lineEndpoints_[i][2];
+            float ey  = edl->lineEndpoints_[i][3];
+            double line_length = sqrt( double( pow(ex-sx,2) + pow(ey-sy,2) ) );
+
+            // create keyline
+            if( line_length > min_line_length )
+            {
+                l_.angle       = edl->lineDirection_[i];
+                l_.startPointX = sx;    l_.sPointInOctaveX = sx;
+                l_.startPointY = sy;    l_.sPointInOctaveY = sy;
+                l_.endPointX   = ex;    l_.ePointInOctaveX = ex;
+                l_.endPointY   = ey;    l_.ePointInOctaveY = ey;
+                l_.lineLength  = line_length;
+                l_.octave      = 0;
+                l_.class_id    = idx_aux;
+                l_.numOfPixels = e_idx - s_idx;
+                l_.response    = line_length / double(max( pyr.gray.cols, pyr.gray.rows ));
+                lines.push_back(l_);
+                idx_aux++;
+            }
+        }
+    }
+    else
+    {
+        if( !lsd )
+        {
+            lsd = LSDDetector::createLSDDetector();
+            // lsd parameters
+            lsd_opts.refine       = Config::lsdRefine();
+            lsd_opts.scale        = Config::lsdScale();
+            lsd_opts.sigma_scale  = Config::lsdSigmaScale();
+            lsd_opts.quant        = Config::lsdQuant();
+            lsd_opts.ang_th       = Config::lsdAngTh();
+            lsd_opts.log_eps      = Config::lsdLogEps();
+            lsd_opts.density_th   = Config::lsdDensityTh();
+            lsd_opts.n_bins       = Config::lsdNBins();
+        }
+        lsd_opts.min_length = min_line_length;
+        lsd->detect( pyr.gray, lines, 1, 1, lsd_opts);
+    }
+
+}
+
+void FeatureExtractor::describeLines(vector<KeyLine> &lines, Mat &ldesc)
+{
+    // LBD leaves ldesc untouched without lines
+    if( lines.empty() )
+        ldesc = Mat();
+    // the EDLines detector keeps the gradients of the image it ran on
+    else if( Config::useEDLines() )
+        lbd->computeFromDetector( *edl, lines, ldesc);
+    else
+        lbd->computeFromGradients( pyr.dx, pyr.dy, lines, ldesc);
+}
+
+}
@@ -0,0 +1,109 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <gridIndex.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace StVO{
+
+GridIndex::GridIndex() : x_min(0.0), y_min(0.0), cell_w(1.0), cell_h(1.0), n_cols(0), n_rows(0) {}
+
+GridIndex::~GridIndex(){}
+
+int GridIndex::cellCol( double x ) const
+{
+    double c = floor( ( x - x_min ) / cell_w );
+    return int( std::min( std::max( c, 0.0 ), double(n_cols-1) ) );
+}
+
+int GridIndex::cellRow( double y ) const
+{
+    double r = floor( ( y - y_min ) / cell_h );
+    return int( std::min( std::max( r, 0.0 ), double(n_rows-1) ) );
+}
+
+void GridIndex::build( const vector<double> &xs_, const vector<double> &ys_, double cell_w_, double cell_h_ )
+{
+
+    xs = xs_;
+    ys = ys_;
+    cell_w = std::max( cell_w_, 1.0 );
+    cell_h = std::max( cell_h_, 1.0 );
+    if( xs.empty() )
+    {
+        n_cols = n_rows = 0;
+        cell_start.assign( 1, 0 );
+        items.clear();
+        return;
+    }
+
+    // grid bounds from the positions themselves
+    double x_max = *max_element( xs.begin(), xs.end() );
+    double y_max = *max_element( ys.begin(), ys.end() );
+    x_min  = *min_element( xs.begin(), xs.end() );
+    y_min  = *min_element( ys.begin(), ys.end() );
+    n_cols = int( floor( ( x_max - x_min ) / cell_w ) ) + 1;
+    n_rows = int( floor( ( y_max - y_min ) / cell_h ) ) + 1;
+
+    // counting sort of the positions by cell
+    vector<int> cell( xs.size() );
+    cell_start.assign( n_cols * n_rows + 1, 0 );
+    for( int i = 0; i < xs.size(); i++ )
+    {
+        cell[i] = cellRow( ys[i] ) * n_cols + cellCol( xs[i] );
+        cell_start[ cell[i] + 1 ]++;
+    }
+    for( int c = 0; c < n_cols * n_rows; c++ )
+        cell_start[c+1] += cell_start[c];
+    vector<int> fill( cell_start.begin(), cell_start.end() - 1 );
+    items.resize( xs.size() );
+    for( int i = 0; i < xs.size(); i++ )
+        items[ fill[cell[i]]++ ] = i;
+
+}
+
+void GridIndex::query( double x0, double y0, double x1, double y1, vector<int> &idx ) const
+{
+
+    if( items.empty() || x1 < x0 || y1 < y0 )
+        return;
+    int c0 = cellCol( x0 ), c1 = cellCol( x1 );
+    int r0 = cellRow( y0 ), r1 = cellRow( y1 );
+    for( int r = r0; r <= r1; r++ )
+    {
+        for( int c = c0; c <= c1; c++ )
+        {
+            int cell = r * n_cols + c;
+            for( int k = cell_start[cell]; k < cell_start[cell+1]; k++ )
+            {
+                int i = items[k];
+                if( xs[i] >= x0 && xs[i] <= x1 && ys[i] >= y0 && ys[i] <= y1 )
+                    idx.push_back( i );
+            }
+        }
+    }
+
+}
+
+}
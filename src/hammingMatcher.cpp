@@ -0,0 +1,365 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <hammingMatcher.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define STVO_HAMMING_X86
+#include <immintrin.h>
+#endif
+
+namespace StVO{
+
+// kernel computing the distances between one 32-byte query and n train rows
+typedef void (*DistKernel)( const uchar* q, const uchar* train, size_t step, int n, int* dist );
+
+// train rows compared at once against every query (32 bytes each, 8KB fit in L1 cache)
+static const int TRAIN_BLOCK = 256;
+
+static inline void insertMatch( KnnMatch2 &m, int idx, int dist )
+{
+    if( dist < m.distance[0] )
+    {
+        m.trainIdx[1] = m.trainIdx[0];  m.distance[1] = m.distance[0];
+        m.trainIdx[0] = idx;            m.distance[0] = dist;
+    }
+    else if( dist < m.distance[1] )
+    {
+        m.trainIdx[1] = idx;            m.distance[1] = dist;
+    }
+}
+
+static inline int hammingScalar( const uchar* a, const uchar* b )
+{
+    int dist = 0;
+    for( int w = 0; w < 4; w++ )
+    {
+        uint64_t wa, wb;
+        memcpy( &wa, a + 8*w, 8 );
+        memcpy( &wb, b + 8*w, 8 );
+        dist += __builtin_popcountll( wa ^ wb );
+    }
+    return dist;
+}
+
+static void distScalar( const uchar* q, const uchar* train, size_t step, int n, int* dist )
+{
+    for( int j = 0; j < n; j++ )
+        dist[j] = hammingScalar( q, train + j*step );
+}
+
+#ifdef STVO_HAMMING_X86
+
+// the per-row popcounts (4 x 64 bits, each <= 64) of four train rows are packed in 16-bit fields
+// and reduced together, so that a single horizontal sum gives the four distances
+__attribute__((target("avx2")))
+static inline void storePacked4( __m256i s0, __m256i s1, __m256i s2, __m256i s3, int* dist )
+{
+    __m256i s = _mm256_or_si256( _mm256_or_si256( s0, _mm256_slli_epi64( s1, 16 ) ),
+                                 _mm256_or_si256( _mm256_slli_epi64( s2, 32 ), _mm256_slli_epi64( s3, 48 ) ) );
+    __m128i h = _mm_add_epi64( _mm256_castsi256_si128( s ), _mm256_extracti128_si256( s, 1 ) );
+    uint64_t d = (uint64_t) _mm_cvtsi128_si64( h ) + (uint64_t) _mm_extract_epi64( h, 1 );
+    dist[0] = int(  d        & 0xffff );
+    dist[1] = int( (d >> 16) & 0xffff );
+    dist[2] = int( (d >> 32) & 0xffff );
+    dist[3] = int( (d >> 48) & 0xffff );
+}
+
+// popcount of the xor through a nibble lookup table, summed per 64-bit lane
+__attribute__((target("avx2")))
+static inline __m256i popcountAVX2( __m256i x )
+{
+    const __m256i lut  = _mm256_setr_epi8( 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                           0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4 );
+    const __m256i mask = _mm256_set1_epi8( 0x0f );
+    __m256i lo  = _mm256_and_si256( x, mask );
+    __m256i hi  = _mm256_and_si256( _mm256_srli_epi16( x, 4 ), mask );
+    __m256i cnt = _mm256_add_epi8( _mm256_shuffle_epi8( lut, lo ), _mm256_shuffle_epi8( lut, hi ) );
+    return _mm256_sad_epu8( cnt, _mm256_setzero_si256() );
+}
+
+__attribute__((target("avx2")))
+static void distAVX2( const uchar* q, const uchar* train, size_t step, int n, int* dist )
+{
+    const __m256i qv = _mm256_loadu_si256( (const __m256i*) q );
+    int j = 0;
+    for( ; j + 4 <= n; j += 4 )
+    {
+        const uchar* t = train + j*step;
+        __m256i s0 = popcountAVX2( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*)  t         ) ) );
+        __m256i s1 = popcountAVX2( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+step)   ) ) );
+        __m256i s2 = popcountAVX2( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+2*step) ) ) );
+        __m256i s3 = popcountAVX2( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+3*step) ) ) );
+        storePacked4( s0, s1, s2, s3, dist + j );
+    }
+    for( ; j < n; j++ )
+        dist[j] = hammingScalar( q, train + j*step );
+}
+
+#if __GNUC__ >= 8
+__attribute__((target("avx512vpopcntdq,avx512vl,avx2")))
+static void distAVX512( const uchar* q, const uchar* train, size_t step, int n, int* dist )
+{
+    const __m256i qv = _mm256_loadu_si256( (const __m256i*) q );
+    int j = 0;
+    for( ; j + 4 <= n; j += 4 )
+    {
+        const uchar* t = train + j*step;
+        __m256i s0 = _mm256_popcnt_epi64( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*)  t         ) ) );
+        __m256i s1 = _mm256_popcnt_epi64( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+step)   ) ) );
+        __m256i s2 = _mm256_popcnt_epi64( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+2*step) ) ) );
+        __m256i s3 = _mm256_popcnt_epi64( _mm256_xor_si256( qv, _mm256_loadu_si256( (const __m256i*) (t+3*step) ) ) );
+        storePacked4( s0, s1, s2, s3, dist + j );
+    }
+    for( ; j < n; j++ )
+        dist[j] = hammingScalar( q, train + j*step );
+}
+#endif
+
+#endif
+
+struct DistKernelInfo
+{
+    DistKernel  kernel;
+    const char* name;
+};
+
+static DistKernelInfo selectKernel()
+{
+    DistKernelInfo info = { distScalar, "scalar" };
+#ifdef STVO_HAMMING_X86
+    __builtin_cpu_init();
+#if __GNUC__ >= 8
+    if( __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512vl") )
+    {
+        info.kernel = distAVX512;
+        info.name   = "avx512-vpopcntdq";
+        return info;
+    }
+#endif
+    if( __builtin_cpu_supports("avx2") )
+    {
+        info.kernel = distAVX2;
+        info.name   = "avx2";
+    }
+#endif
+    return info;
+}
+
+// resolved once, on first use
+static const DistKernelInfo& kernelInfo()
+{
+    static const DistKernelInfo info = selectKernel();
+    return info;
+}
+
+// Walks the distance matrix once, by blocks of train rows that stay in cache while every query
+// is compared against them, keeping the best two matches of each row and, if best_21 is given,
+// the best match of each column. Rows and columns are visited in increasing order with strict
+// comparisons, so ties resolve to the lowest index as two separate knnMatch calls would.
+static void matchBlocked( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches *best_21 )
+{
+
+    DistKernel kernel = kernelInfo().kernel;
+    int n_query = desc_1.rows;
+    int n_train = desc_2.rows;
+
+    matches_12.resize( n_query );
+    for( int i = 0; i < n_query; i++ )
+    {
+        matches_12[i].trainIdx[0] = matches_12[i].trainIdx[1] = -1;
+        matches_12[i].distance[0] = matches_12[i].distance[1] = INT_MAX;
+    }
+
+    // column minima kept in contiguous arrays so that their update vectorizes
+    vector<int> col_dist, col_idx;
+    if( best_21 != NULL )
+    {
+        col_dist.assign( n_train, INT_MAX );
+        col_idx.assign( n_train, -1 );
+    }
+
+    int dist[TRAIN_BLOCK];
+    for( int j0 = 0; j0 < n_train; j0 += TRAIN_BLOCK )
+    {
+        int n_block = std::min( TRAIN_BLOCK, n_train - j0 );
+        const uchar* train = desc_2.ptr<uchar>(j0);
+        for( int i = 0; i < n_query; i++ )
+        {
+            kernel( desc_1.ptr<uchar>(i), train, desc_2.step, n_block, dist );
+            KnnMatch2 &m = matches_12[i];
+            for( int j = 0; j < n_block; j++ )
+            {
+                if( dist[j] < m.distance[1] )
+                    insertMatch( m, j0+j, dist[j] );
+            }
+            if( best_21 != NULL )
+            {
+                int* cd = &col_dist[j0];
+                int* ci = &col_idx[j0];
+                for( int j = 0; j < n_block; j++ )
+                {
+                    bool better = dist[j] < cd[j];
+                    cd[j] = better ? dist[j] : cd[j];
+                    ci[j] = better ? i : ci[j];
+                }
+            }
+        }
+    }
+
+    if( best_21 != NULL )
+    {
+        best_21->resize( n_train );
+        for( int j = 0; j < n_train; j++ )
+        {
+            KnnMatch2 &m = (*best_21)[j];
+            m.trainIdx[0] = col_idx[j];     m.distance[0] = col_dist[j];
+            m.trainIdx[1] = -1;             m.distance[1] = INT_MAX;
+        }
+    }
+
+}
+
+// Same as matchBlocked, but each row of desc_1 is only compared against its candidate rows of
+// desc_2 (cand[offsets[i]] ... cand[offsets[i+1]-1], increasing). The candidates are gathered in
+// a contiguous buffer so that the same distance kernels are used. Columns only see the rows that
+// list them as candidates, so the cross-check is consistent if the candidate relation is symmetric.
+static void matchCandidates( const Mat &desc_1, const Mat &desc_2, const vector<int> &offsets, const vector<int> &cand,
+                             KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+
+    DistKernel kernel = kernelInfo().kernel;
+    int n_query = desc_1.rows;
+    int n_train = desc_2.rows;
+
+    matches_12.resize( n_query );
+    vector<int> col_dist( n_train, INT_MAX ), col_idx( n_train, -1 );
+
+    int   dist[TRAIN_BLOCK];
+    uchar gathered[TRAIN_BLOCK*32];
+    for( int i = 0; i < n_query; i++ )
+    {
+        KnnMatch2 &m = matches_12[i];
+        m.trainIdx[0] = m.trainIdx[1] = -1;
+        m.distance[0] = m.distance[1] = INT_MAX;
+        const uchar* q = desc_1.ptr<uchar>(i);
+        for( int k0 = offsets[i]; k0 < offsets[i+1]; k0 += TRAIN_BLOCK )
+        {
+            int n_block = std::min( TRAIN_BLOCK, offsets[i+1] - k0 );
+            for( int k = 0; k < n_block; k++ )
+                memcpy( gathered + 32*k, desc_2.ptr<uchar>( cand[k0+k] ), 32 );
+            kernel( q, gathered, 32, n_block, dist );
+            for( int k = 0; k < n_block; k++ )
+            {
+                int j = cand[k0+k];
+                if( dist[k] < m.distance[1] )
+                    insertMatch( m, j, dist[k] );
+                if( dist[k] < col_dist[j] )
+                {
+                    col_dist[j] = dist[k];
+                    col_idx[j]  = i;
+                }
+            }
+        }
+    }
+
+    matches_21.resize( n_train );
+    for( int j = 0; j < n_train; j++ )
+    {
+        KnnMatch2 &m = matches_21[j];
+        m.trainIdx[0] = col_idx[j];     m.distance[0] = col_dist[j];
+        m.trainIdx[1] = -1;             m.distance[1] = INT_MAX;
+    }
+
+}
+
+// missing matches are reported at the maximum distance instead of the INT_MAX sentinel
+static void setMissingDistance( KnnMatches &matches, int max_dist )
+{
+    for( int i = 0; i < matches.size(); i++ )
+    {
+        for( int l = 0; l < 2; l++ )
+        {
+            if( matches[i].trainIdx[l] < 0 )
+                matches[i].distance[l] = max_dist;
+        }
+    }
+}
+
+void toKnnMatches( const vector<vector<DMatch>> &dmatches, int n_query, int max_dist, KnnMatches &matches )
+{
+    matches.resize( n_query );
+    for( int i = 0; i < n_query; i++ )
+    {
+        matches[i].trainIdx[0] = matches[i].trainIdx[1] = -1;
+        matches[i].distance[0] = matches[i].distance[1] = max_dist;
+    }
+    for( int i = 0; i < dmatches.size(); i++ )
+    {
+        for( int l = 0; l < dmatches[i].size() && l < 2; l++ )
+        {
+            const DMatch &dm = dmatches[i][l];
+            if( dm.queryIdx < 0 || dm.queryIdx >= n_query )
+                continue;
+            matches[dm.queryIdx].trainIdx[l] = dm.trainIdx;
+            matches[dm.queryIdx].distance[l] = int( dm.distance );
+        }
+    }
+}
+
+bool HammingMatcher::supports( const Mat &desc_1, const Mat &desc_2 )
+{
+    return desc_1.type() == CV_8UC1 && desc_1.cols == 32 && desc_2.type() == CV_8UC1 && desc_2.cols == 32;
+}
+
+void HammingMatcher::knnMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12 )
+{
+    matchBlocked( desc_1, desc_2, matches_12, NULL );
+    setMissingDistance( matches_12, 8 * desc_2.cols );
+}
+
+void HammingMatcher::crossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    matchBlocked( desc_1, desc_2, matches_12, &matches_21 );
+    setMissingDistance( matches_12, 8 * desc_2.cols );
+    setMissingDistance( matches_21, 8 * desc_1.cols );
+}
+
+void HammingMatcher::crossCheckMatch( const Mat &desc_1, const Mat &desc_2, const vector<int> &offsets, const vector<int> &cand,
+                                      KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    matchCandidates( desc_1, desc_2, offsets, cand, matches_12, matches_21 );
+    setMissingDistance( matches_12, 8 * desc_2.cols );
+    setMissingDistance( matches_21, 8 * desc_1.cols );
+}
+
+const char* HammingMatcher::kernelName()
+{
+    return kernelInfo().name;
+}
+
+}
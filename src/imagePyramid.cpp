@@ -0,0 +1,70 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <imagePyramid.h>
+
+namespace StVO{
+
+ImagePyramid::ImagePyramid(){}
+
+ImagePyramid::~ImagePyramid(){}
+
+void ImagePyramid::compute( const Mat &img, int n_octaves, int reduction_ratio, bool gradients )
+{
+    computeGray( img );
+    computeOctaves( n_octaves, reduction_ratio, gradients );
+}
+
+void ImagePyramid::computeGray( const Mat &img )
+{
+    // grayscale conversion (the buffers keep their memory between frames of the same size)
+    if( img.channels() != 1 )
+    {
+        cvtColor( img, gray_buf, COLOR_BGR2GRAY );
+        gray = gray_buf;
+    }
+    else
+        gray = img;
+}
+
+void ImagePyramid::computeOctaves( int n_octaves, int reduction_ratio, bool gradients )
+{
+
+    // smoothed pyramid and derivatives
+    octaves.resize( n_octaves );
+    dx.resize( gradients ? n_octaves : 0 );
+    dy.resize( gradients ? n_octaves : 0 );
+    for( int i = 0; i < n_octaves; i++ )
+    {
+        if( i == 0 )
+            GaussianBlur( gray, octaves[0], Size( 5, 5 ), 1 );
+        else
+            pyrDown( octaves[i-1], octaves[i], Size( octaves[i-1].cols / reduction_ratio, octaves[i-1].rows / reduction_ratio ) );
+        if( !gradients )
+            continue;
+        Sobel( octaves[i], dx[i], CV_16SC1, 1, 0, 3 );
+        Sobel( octaves[i], dy[i], CV_16SC1, 0, 1, 3 );
+    }
+
+}
+
+}
@@ -0,0 +1,201 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <matcherCostModel.h>
+
+#include <algorithm>
+#include <cfloat>
+
+#include <opencv2/line_descriptor.hpp>
+#include <opencv2/line_descriptor/descriptor.hpp>
+using namespace cv::line_descriptor;
+
+#include <eigen3/Eigen/Dense>
+using namespace Eigen;
+
+#include <config.h>
+#include <hammingMatcher.h>
+
+namespace StVO{
+
+// repetitions of each timing (the minimum is kept)
+static const int CALIB_REPS = 3;
+
+// time (ms) of the fastest of CALIB_REPS runs of f
+template<class F>
+static double minTime( F f )
+{
+    double t_min = DBL_MAX;
+    for( int r = 0; r < CALIB_REPS; r++ )
+    {
+        double t0 = (double) getTickCount();
+        f();
+        t_min = std::min( t_min, 1000.0 * ( (double) getTickCount() - t0 ) / getTickFrequency() );
+    }
+    return t_min;
+}
+
+MatcherCostModel::MatcherCostModel() :
+    lin_fixed(0.0), lin_pair(0.0), mih_fixed(0.0), mih_desc(0.0)
+{
+    const string &file = Config::matcherModelFile();
+    if( file.empty() || !load( file ) )
+    {
+        calibrate();
+        if( !file.empty() )
+            save( file );
+    }
+}
+
+MatcherCostModel& MatcherCostModel::getInstance()
+{
+    static MatcherCostModel instance;
+    return instance;
+}
+
+MatchStrategy MatcherCostModel::select( int n_1, int n_2 ) const
+{
+    return mihCost( n_1, n_2 ) < linearCost( n_1, n_2 ) ? MATCH_MIH : MATCH_LINEAR;
+}
+
+double MatcherCostModel::linearCost( int n_1, int n_2 ) const
+{
+    return lin_fixed + lin_pair * double(n_1) * double(n_2);
+}
+
+double MatcherCostModel::mihCost( int n_1, int n_2 ) const
+{
+    return mih_fixed + mih_desc * double( n_1 + n_2 );
+}
+
+void MatcherCostModel::calibrate()
+{
+
+    // synthetic descriptors, the matchers' cost does not depend on their content
+    static const int sizes[][2] = { {64,64}, {200,200}, {400,400}, {800,800}, {200,800}, {800,200} };
+    RNG rng( 0x5eed );
+    Mat desc( 800, 32, CV_8UC1 ), desc_( 800, 32, CV_8UC1 );
+    rng.fill( desc,  RNG::UNIFORM, 0, 256 );
+    rng.fill( desc_, RNG::UNIFORM, 0, 256 );
+
+    vector<vector<double>> A_lin, A_mih;
+    vector<double> t_lin, t_mih;
+    for( int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++ )
+    {
+        int n_1 = sizes[s][0], n_2 = sizes[s][1];
+        Mat desc_1 = desc.rowRange( 0, n_1 ), desc_2 = desc_.rowRange( 0, n_2 );
+
+        KnnMatches km_12, km_21;
+        t_lin.push_back( minTime( [&](){ HammingMatcher::crossCheckMatch( desc_1, desc_2, km_12, km_21 ); } ) );
+        A_lin.push_back( { 1.0, double(n_1) * double(n_2) } );
+
+        t_mih.push_back( minTime( [&](){ mihCrossCheckMatch( desc_1, desc_2, km_12, km_21 ); } ) );
+        A_mih.push_back( { 1.0, double( n_1 + n_2 ) } );
+    }
+
+    vector<double> c;
+    fit( A_lin, t_lin, c );
+    lin_fixed = c[0]; lin_pair = c[1];
+    fit( A_mih, t_mih, c );
+    mih_fixed = c[0]; mih_desc = c[1];
+
+}
+
+void MatcherCostModel::fit( const vector<vector<double>> &A, const vector<double> &t, vector<double> &coeffs )
+{
+    MatrixXd A_( A.size(), A[0].size() );
+    VectorXd t_( t.size() );
+    for( int i = 0; i < A.size(); i++ )
+    {
+        for( int j = 0; j < A[i].size(); j++ )
+            A_(i,j) = A[i][j];
+        t_(i) = t[i];
+    }
+    VectorXd c_ = A_.colPivHouseholderQr().solve( t_ );
+    coeffs.resize( c_.size() );
+    for( int j = 0; j < c_.size(); j++ )
+        coeffs[j] = std::max( c_(j), 0.0 );
+}
+
+bool MatcherCostModel::load( const string &file )
+{
+    FileStorage fs( file, FileStorage::READ );
+    if( !fs.isOpened() )
+        return false;
+    // timings are only valid for the kernel they were measured with
+    string kernel;
+    fs["kernel"] >> kernel;
+    if( kernel != HammingMatcher::kernelName() )
+        return false;
+    fs["lin_fixed"] >> lin_fixed;
+    fs["lin_pair"]  >> lin_pair;
+    fs["mih_fixed"] >> mih_fixed;
+    fs["mih_desc"]  >> mih_desc;
+    return true;
+}
+
+bool MatcherCostModel::save( const string &file ) const
+{
+    FileStorage fs( file, FileStorage::WRITE );
+    if( !fs.isOpened() )
+        return false;
+    fs << "kernel"    << string( HammingMatcher::kernelName() );
+    fs << "lin_fixed" << lin_fixed;
+    fs << "lin_pair"  << lin_pair;
+    fs << "mih_fixed" << mih_fixed;
+    fs << "mih_desc"  << mih_desc;
+    return true;
+}
+
+void MatcherCostModel::mihCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+    vector<vector<DMatch>> dmatches_12, dmatches_21;
+    bdm->knnMatch( desc_1, desc_2, dmatches_12, 2 );
+    bdm->knnMatch( desc_2, desc_1, dmatches_21, 2 );
+    toKnnMatches( dmatches_12, desc_1.rows, 8 * desc_2.cols, matches_12 );
+    toKnnMatches( dmatches_21, desc_2.rows, 8 * desc_1.cols, matches_21 );
+    // as the linear cross-check, which only finds the best match of desc_2
+    for( int j = 0; j < matches_21.size(); j++ )
+    {
+        matches_21[j].trainIdx[1] = -1;
+        matches_21[j].distance[1] = 8 * desc_1.cols;
+    }
+}
+
+void MatcherCostModel::adaptiveCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    if( Config::adaptiveMatching() && getInstance().select( desc_1.rows, desc_2.rows ) == MATCH_MIH )
+        mihCrossCheckMatch( desc_1, desc_2, matches_12, matches_21 );
+    else
+        HammingMatcher::crossCheckMatch( desc_1, desc_2, matches_12, matches_21 );
+}
+
+void MatcherCostModel::adaptiveCrossCheckMatch( const Mat &desc_1, const Mat &desc_2, const vector<int> &offsets, const vector<int> &cand,
+                                                KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    // the global matchers would ignore the geometric gating (and the matches would depend on the
+    // timings), so the candidates are always matched with the bucketed cross-check
+    HammingMatcher::crossCheckMatch( desc_1, desc_2, offsets, cand, matches_12, matches_21 );
+}
+
+}
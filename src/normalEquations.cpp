@@ -0,0 +1,251 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <normalEquations.h>
+#include <threadPool.h>
+#include <cstring>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define STVO_NORMAL_EQ_X86
+#include <immintrin.h>
+#endif
+
+namespace StVO{
+
+// kernel adding the residuals first ... n-1 to the upper triangle of H (21 entries, row-major) and to g
+typedef void (*SumKernel)( const double* const* J, const double* wh, const double* wg, int first, int n, double* h, double* g );
+
+static void sumScalar( const double* const* J, const double* wh, const double* wg, int first, int n, double* h, double* g )
+{
+    for( int k = first; k < n; k++ )
+    {
+        int idx = 0;
+        for( int i = 0; i < 6; i++ )
+        {
+            double wJ_i = wh[k] * J[i][k];
+            for( int j = i; j < 6; j++, idx++ )
+                h[idx] += wJ_i * J[j][k];
+            g[i] += wg[k] * J[i][k];
+        }
+    }
+}
+
+#ifdef STVO_NORMAL_EQ_X86
+
+__attribute__((target("avx2,fma")))
+static inline double hsumAVX2( __m256d v )
+{
+    __m128d s = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+    return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+}
+
+// four residuals per step, each lane keeping its own partial sums until the end
+__attribute__((target("avx2,fma")))
+static void sumAVX2( const double* const* J, const double* wh, const double* wg, int first, int n, double* h, double* g )
+{
+    __m256d acc_h[21], acc_g[6];
+    for( int idx = 0; idx < 21; idx++ )
+        acc_h[idx] = _mm256_setzero_pd();
+    for( int i = 0; i < 6; i++ )
+        acc_g[i] = _mm256_setzero_pd();
+    int k = first;
+    for( ; k + 4 <= n; k += 4 )
+    {
+        __m256d J_k[6];
+        for( int i = 0; i < 6; i++ )
+            J_k[i] = _mm256_loadu_pd( J[i] + k );
+        __m256d wh_k = _mm256_loadu_pd( wh + k );
+        __m256d wg_k = _mm256_loadu_pd( wg + k );
+        int idx = 0;
+        for( int i = 0; i < 6; i++ )
+        {
+            __m256d wJ_i = _mm256_mul_pd( wh_k, J_k[i] );
+            for( int j = i; j < 6; j++, idx++ )
+                acc_h[idx] = _mm256_fmadd_pd( wJ_i, J_k[j], acc_h[idx] );
+            acc_g[i] = _mm256_fmadd_pd( wg_k, J_k[i], acc_g[i] );
+        }
+    }
+    for( int idx = 0; idx < 21; idx++ )
+        h[idx] += hsumAVX2( acc_h[idx] );
+    for( int i = 0; i < 6; i++ )
+        g[i] += hsumAVX2( acc_g[i] );
+    sumScalar( J, wh, wg, k, n, h, g );
+}
+
+#endif
+
+struct SumKernelInfo
+{
+    SumKernel   kernel;
+    const char* name;
+};
+
+static bool supportsAVX2()
+{
+#ifdef STVO_NORMAL_EQ_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+static SumKernelInfo selectKernel()
+{
+    SumKernelInfo info = { sumScalar, "scalar" };
+#ifdef STVO_NORMAL_EQ_X86
+    if( supportsAVX2() )
+    {
+        info.kernel = sumAVX2;
+        info.name   = "avx2-fma";
+    }
+#endif
+    return info;
+}
+
+// residuals summed together, the unit of the deterministic reduction
+static const int SUM_CHUNK = 256;
+
+// resolved once, on first use
+static SumKernelInfo& kernelInfo()
+{
+    static SumKernelInfo info = selectKernel();
+    return info;
+}
+
+void NormalEquations::clear()
+{
+    resize( 0 );
+}
+
+void NormalEquations::resize( int n )
+{
+    // unset slots have null weights and jacobians, so the kernel can run over them
+    for( int i = 0; i < 6; i++ )
+        J[i].assign( n, 0.0 );
+    wh.assign( n, 0.0 );
+    wg.assign( n, 0.0 );
+    e.assign( n, 0.0 );
+    used.assign( n, false );
+}
+
+void NormalEquations::set( int k, const Vector6d &J_, double wh_, double wg_, double e_ )
+{
+    for( int i = 0; i < 6; i++ )
+        J[i][k] = J_(i);
+    wh[k]   = wh_;
+    wg[k]   = wg_;
+    e[k]    = e_;
+    used[k] = true;
+}
+
+void NormalEquations::errors( vector<double> &e_ ) const
+{
+    e_.clear();
+    for( int k = 0; k < size(); k++ )
+    {
+        if( used[k] )
+            e_.push_back( e[k] );
+    }
+}
+
+void NormalEquations::sum( Matrix6d &H, Vector6d &g, double &e_, int &n, bool parallel ) const
+{
+
+    // partial sums of each chunk, then added in chunk order
+    const double* J_[6];
+    for( int i = 0; i < 6; i++ )
+        J_[i] = J[i].data();
+    int n_chunks = ( size() + SUM_CHUNK - 1 ) / SUM_CHUNK;
+    vector<double> partial( 27 * n_chunks, 0.0 );
+    SumKernel kernel = kernelInfo().kernel;
+    auto sumChunk = [&]( int c ){
+        kernel( J_, wh.data(), wg.data(), c * SUM_CHUNK, std::min( (c+1) * SUM_CHUNK, size() ), &partial[27*c], &partial[27*c+21] );
+    };
+    if( parallel )
+        ThreadPool::getInstance().parallelFor( n_chunks, 1, sumChunk );
+    else
+    {
+        for( int c = 0; c < n_chunks; c++ )
+            sumChunk( c );
+    }
+    double h_[21] = { 0.0 }, g_[6] = { 0.0 };
+    for( int c = 0; c < n_chunks; c++ )
+    {
+        for( int idx = 0; idx < 21; idx++ )
+            h_[idx] += partial[27*c+idx];
+        for( int i = 0; i < 6; i++ )
+            g_[i] += partial[27*c+21+i];
+    }
+
+    // error and number of residuals, in slot order
+    e_ = 0.0;
+    n  = 0;
+    for( int k = 0; k < size(); k++ )
+    {
+        if( used[k] )
+        {
+            e_ += e[k];
+            n++;
+        }
+    }
+
+    // mirror the upper triangle
+    int idx = 0;
+    for( int i = 0; i < 6; i++ )
+    {
+        for( int j = i; j < 6; j++, idx++ )
+        {
+            H(i,j) = h_[idx];
+            H(j,i) = h_[idx];
+        }
+        g(i) = g_[i];
+    }
+
+}
+
+const char* NormalEquations::kernelName()
+{
+    return kernelInfo().name;
+}
+
+bool NormalEquations::setKernel( const char* name )
+{
+    SumKernelInfo info = { sumScalar, "scalar" };
+    if( strcmp( name, "avx2-fma" ) == 0 )
+    {
+#ifdef STVO_NORMAL_EQ_X86
+        if( !supportsAVX2() )
+            return false;
+        info.kernel = sumAVX2;
+        info.name   = "avx2-fma";
+#else
+        return false;
+#endif
+    }
+    else if( strcmp( name, "scalar" ) != 0 )
+        return false;
+    kernelInfo() = info;
+    return true;
+}
+
+}
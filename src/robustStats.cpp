@@ -0,0 +1,104 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <robustStats.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace StVO{
+
+double medianSelect( vector<double> &x )
+{
+    if( x.empty() )
+        return 0.0;
+    nth_element( x.begin(), x.begin() + x.size()/2, x.end() );
+    return x[x.size()/2];
+}
+
+float medianSelect( float* x, int n )
+{
+    if( n <= 0 )
+        return 0.f;
+    nth_element( x, x + n/2, x + n );
+    return x[n/2];
+}
+
+double stdvMADSelect( vector<double> &x )
+{
+    if( x.empty() )
+        return 0.0;
+    double median = medianSelect( x );
+    for( int i = 0; i < x.size(); i++ )
+        x[i] = fabs( x[i] - median );
+    return 1.4826 * medianSelect( x );
+}
+
+double stdvMADSelect( float* x, int n )
+{
+    if( n <= 0 )
+        return 0.0;
+    float median = medianSelect( x, n );
+    for( int i = 0; i < n; i++ )
+        x[i] = fabsf( x[i] - median );
+    return 1.4826 * medianSelect( x, n );
+}
+
+// smallest value whose cumulative count exceeds n/2
+static int histogramMedian( const vector<int> &hist, int n )
+{
+    int acc = 0;
+    for( int v = 0; v < hist.size(); v++ )
+    {
+        acc += hist[v];
+        if( acc > n/2 )
+            return v;
+    }
+    return int(hist.size()) - 1;
+}
+
+int medianHistogram( const vector<int> &x, int max_val )
+{
+    if( x.empty() )
+        return 0;
+    vector<int> hist( max_val+1, 0 );
+    for( int i = 0; i < x.size(); i++ )
+        hist[ std::min( std::max( x[i], 0 ), max_val ) ]++;
+    return histogramMedian( hist, x.size() );
+}
+
+double stdvMADHistogram( const vector<int> &x, int max_val )
+{
+    if( x.empty() )
+        return 0.0;
+    vector<int> hist( max_val+1, 0 );
+    for( int i = 0; i < x.size(); i++ )
+        hist[ std::min( std::max( x[i], 0 ), max_val ) ]++;
+    int median = histogramMedian( hist, x.size() );
+    // the absolute deviations are integers in [0,max_val] too
+    vector<int> hist_dev( max_val+1, 0 );
+    for( int v = 0; v <= max_val; v++ )
+        hist_dev[ abs( v - median ) ] += hist[v];
+    return 1.4826 * histogramMedian( hist_dev, x.size() );
+}
+
+}
@@ -0,0 +1,165 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <se3.h>
+
+#include <cmath>
+
+namespace StVO{
+
+// below this rotation angle the coefficients that cancel catastrophically in closed form
+// (theta - sin(theta) and the like) are evaluated with their Taylor series up to theta^6,
+// whose truncation error is below the double precision there
+static const double SERIES_ANGLE = 0.1;
+
+static Matrix3d hat( const Vector3d &w )
+{
+    Matrix3d W;
+    W <<  0.0,  -w(2),  w(1),
+          w(2),  0.0,  -w(0),
+         -w(1),  w(0),  0.0;
+    return W;
+}
+
+static Vector3d vee( const Matrix3d &M )
+{
+    return Vector3d( M(2,1) - M(1,2), M(0,2) - M(2,0), M(1,0) - M(0,1) );
+}
+
+// sin(theta)/theta and (1-cos(theta))/theta^2, written without cancellation
+static double sinc( double theta )
+{
+    return theta < 1e-8 ? 1.0 - theta * theta / 6.0 : sin(theta) / theta;
+}
+
+static double cosc( double theta )
+{
+    double s = sinc( 0.5 * theta );
+    return 0.5 * s * s;
+}
+
+// (theta - sin(theta))/theta^3
+static double sinc3( double theta )
+{
+    double t2 = theta * theta;
+    if( theta < SERIES_ANGLE )
+        return 1.0/6.0 - t2 * ( 1.0/120.0 - t2 * ( 1.0/5040.0 - t2 / 362880.0 ) );
+    return ( theta - sin(theta) ) / ( t2 * theta );
+}
+
+// left jacobian of SO(3), V(w) in the translation of exp
+static Matrix3d leftJacobianSO3( const Vector3d &w )
+{
+    double theta = w.norm();
+    Matrix3d W = hat( w );
+    return Matrix3d::Identity() + cosc( theta ) * W + sinc3( theta ) * W * W;
+}
+
+SE3 SE3::exp( const Vector6d &x )
+{
+    Vector3d v = x.head<3>();
+    Vector3d w = x.tail<3>();
+    double theta = w.norm();
+    Matrix3d W = hat( w );
+    Matrix3d R_ = Matrix3d::Identity() + sinc( theta ) * W + cosc( theta ) * W * W;
+    return SE3( R_, leftJacobianSO3( w ) * v );
+}
+
+Vector6d SE3::log() const
+{
+    // the angle from both its sine and cosine is accurate over the whole range, unlike acos
+    Vector3d vee_R = vee( R );
+    double theta = atan2( 0.5 * vee_R.norm(), 0.5 * ( R.trace() - 1.0 ) );
+    Vector3d w;
+    if( theta < 0.5 * M_PI )
+        w = ( 0.5 / sinc( theta ) ) * vee_R;
+    else
+    {
+        // R - R^T vanishes near pi, so the axis a is taken from the symmetric part,
+        // (R + R^T)/2 - cos(theta) I = (1 - cos(theta)) a a^T, at its largest diagonal entry
+        Matrix3d A = 0.5 * ( R + R.transpose() ) - cos(theta) * Matrix3d::Identity();
+        int k;
+        A.diagonal().maxCoeff( &k );
+        w = A.col( k ) / sqrt( A(k,k) );
+        if( w.dot( vee_R ) < 0.0 )
+            w = -w;
+        w *= theta / w.norm();
+    }
+
+    // inverse of V(w), I - W/2 + (1 - (theta/2) cot(theta/2)) / theta^2 W^2
+    double t2 = theta * theta, c;
+    if( theta < SERIES_ANGLE )
+        c = 1.0/12.0 + t2 * ( 1.0/720.0 + t2 * ( 1.0/30240.0 + t2 / 1209600.0 ) );
+    else
+        c = ( 1.0 - 0.5 * theta / tan( 0.5 * theta ) ) / t2;
+    Matrix3d W = hat( w );
+    Matrix3d V_inv = Matrix3d::Identity() - 0.5 * W + c * W * W;
+
+    Vector6d x;
+    x << V_inv * t, w;
+    return x;
+}
+
+Matrix4d SE3::matrix() const
+{
+    Matrix4d T = Matrix4d::Identity();
+    T.block<3,3>(0,0) = R;
+    T.block<3,1>(0,3) = t;
+    return T;
+}
+
+Matrix6d SE3::leftJacobian( const Vector6d &x )
+{
+    Vector3d v = x.head<3>();
+    Vector3d w = x.tail<3>();
+    Matrix3d V = hat( v );
+    Matrix3d W = hat( w );
+
+    // coefficients of the coupling block Q(v,w) (Barfoot, State Estimation for Robotics, 7.86)
+    double theta = w.norm(), t2 = theta * theta;
+    double c1 = sinc3( theta ), c2, c3;
+    if( theta < SERIES_ANGLE )
+    {
+        c2 = 1.0/24.0  - t2 * ( 1.0/720.0  - t2 * ( 1.0/40320.0  - t2 / 3628800.0 ) );
+        c3 = 1.0/120.0 - t2 * ( 1.0/2520.0 - t2 * ( 1.0/120960.0 - t2 / 9979200.0 ) );
+    }
+    else
+    {
+        double s = sin(theta), c = cos(theta);
+        c2 = ( t2 + 2.0 * c - 2.0 ) / ( 2.0 * t2 * t2 );
+        c3 = ( 2.0 * theta - 3.0 * s + theta * c ) / ( 2.0 * t2 * t2 * theta );
+    }
+    Matrix3d WV  = W * V;
+    Matrix3d WVW = WV * W;
+    Matrix3d Q = 0.5 * V
+               + c1 * ( WV + V * W + WVW )
+               + c2 * ( W * WV + V * W * W - 3.0 * WVW )
+               + c3 * ( WVW * W + W * WVW );
+
+    Matrix6d J = Matrix6d::Zero();
+    J.block<3,3>(0,0) = leftJacobianSO3( w );
+    J.block<3,3>(3,3) = J.block<3,3>(0,0);
+    J.block<3,3>(0,3) = Q;
+    return J;
+}
+
+}
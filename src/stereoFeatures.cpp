@@ -19,44 +19,127 @@
 **																			**
 *****************************************************************************/
 
+
 #include <stereoFeatures.h>
 
 namespace StVO{
 
-PointFeature::PointFeature( Vector2d pl_, double disp_, Vector3d P_ ) :
-    pl(pl_), disp(disp_), P(P_), inlier(true)
-{}
-
-PointFeature::PointFeature( Vector2d pl_, double disp_, Vector3d P_, int idx_ ) :
-    pl(pl_), disp(disp_), P(P_), inlier(true), idx(idx_)
-{}
-
-PointFeature::PointFeature( Vector2d pl_, double disp_, Vector3d P_, Vector2d pl_obs_ ) :
-    pl(pl_), disp(disp_), P(P_), pl_obs(pl_obs_), inlier(true)
-{}
-
-LineFeature::LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                          Vector2d epl_, double edisp_, Vector3d eP_, Vector3d le_) :
-    spl(spl_), sdisp(sdisp_), sP(sP_), epl(epl_), edisp(edisp_), eP(eP_), le(le_), inlier(true)
-{}
-
-LineFeature::LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                          Vector2d epl_, double edisp_, Vector3d eP_,
-                          Vector3d le_, Vector3d le_obs_ ) :
-    spl(spl_), sdisp(sdisp_), sP(sP_), epl(epl_), edisp(edisp_), eP(eP_), le(le_), le_obs(le_obs_), inlier(true)
-{}
-
-LineFeature::LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                          Vector2d epl_, double edisp_, Vector3d eP_,
-                          Vector3d le_,  int    idx_) :
-    spl(spl_), sdisp(sdisp_), sP(sP_), epl(epl_), edisp(edisp_), eP(eP_), le(le_), inlier(true), idx(idx_)
-{}
-
-LineFeature::LineFeature( Vector2d spl_, double sdisp_, Vector3d sP_,
-                          Vector2d epl_, double edisp_, Vector3d eP_,
-                          Vector3d le_,  double angle_, int    idx_) :
-    spl(spl_), sdisp(sdisp_), sP(sP_), epl(epl_), edisp(edisp_), eP(eP_), le(le_), inlier(true), idx(idx_), angle(angle_)
-{}
+Matrix3d backProjectionCov( const Vector2d &pl, double disp, double f, double cx, double cy )
+{
+    double px_hat = pl(0) - cx;
+    double py_hat = pl(1) - cy;
+    double disp2  = disp * disp;
+    Matrix3d cov;
+    cov(0,0) = disp2 + 2.0*px_hat*px_hat;
+    cov(0,1) = 2.0*px_hat*py_hat;
+    cov(0,2) = 2.0*f*px_hat;
+    cov(1,1) = disp2 + 2.0*py_hat*py_hat;
+    cov(1,2) = 2.0*f*py_hat;
+    cov(2,2) = 2.0*f*f;
+    cov(1,0) = cov(0,1);
+    cov(2,0) = cov(0,2);
+    cov(2,1) = cov(1,2);
+    return cov / (disp2*disp2);
+}
+
+void PointFeatures::clear()
+{
+    idx.clear();
+    pl.clear();
+    disp.clear();
+    P.clear();
+}
+
+void PointFeatures::push_back( const Vector2d &pl_, double disp_, const Vector3d &P_, int idx_ )
+{
+    idx.push_back( idx_ );
+    pl.push_back( pl_ );
+    disp.push_back( disp_ );
+    P.push_back( P_ );
+}
 
+void LineFeatures::clear()
+{
+    idx.clear();
+    spl.clear();    epl.clear();
+    sdisp.clear();  edisp.clear();
+    sP.clear();     eP.clear();
+    le.clear();
+    angle.clear();
+}
+
+void LineFeatures::push_back( const Vector2d &spl_, double sdisp_, const Vector3d &sP_,
+                              const Vector2d &epl_, double edisp_, const Vector3d &eP_,
+                              const Vector3d &le_,  double angle_, int idx_ )
+{
+    idx.push_back( idx_ );
+    spl.push_back( spl_ );      epl.push_back( epl_ );
+    sdisp.push_back( sdisp_ );  edisp.push_back( edisp_ );
+    sP.push_back( sP_ );        eP.push_back( eP_ );
+    le.push_back( le_ );
+    angle.push_back( angle_ );
+}
+
+void PointMatches::clear()
+{
+    prev.clear();   curr.clear();
+    P.clear();
+    pl.clear();
+    disp.clear();
+    pl_obs.clear();
+    inlier.clear();
+    covP.clear();
+}
+
+void PointMatches::push_back( const PointFeatures &f_prev, int i_prev, const PointFeatures &f_curr, int i_curr )
+{
+    prev.push_back( i_prev );   curr.push_back( i_curr );
+    P.push_back( f_prev.P[i_prev] );
+    pl.push_back( f_prev.pl[i_prev] );
+    disp.push_back( f_prev.disp[i_prev] );
+    pl_obs.push_back( f_curr.pl[i_curr] );
+    inlier.push_back( true );
+}
+
+void PointMatches::computeCovariances( double f, double cx, double cy )
+{
+    covP.resize( size() );
+    for( int i = 0; i < size(); i++ )
+        covP[i] = backProjectionCov( pl[i], disp[i], f, cx, cy );
+}
+
+void LineMatches::clear()
+{
+    prev.clear();       curr.clear();
+    sP.clear();         eP.clear();
+    spl.clear();        epl.clear();
+    sdisp.clear();      edisp.clear();
+    spl_obs.clear();    epl_obs.clear();
+    le_obs.clear();
+    inlier.clear();
+    covS.clear();       covE.clear();
+}
+
+void LineMatches::push_back( const LineFeatures &f_prev, int i_prev, const LineFeatures &f_curr, int i_curr )
+{
+    prev.push_back( i_prev );               curr.push_back( i_curr );
+    sP.push_back( f_prev.sP[i_prev] );      eP.push_back( f_prev.eP[i_prev] );
+    spl.push_back( f_prev.spl[i_prev] );    epl.push_back( f_prev.epl[i_prev] );
+    sdisp.push_back( f_prev.sdisp[i_prev] );    edisp.push_back( f_prev.edisp[i_prev] );
+    spl_obs.push_back( f_curr.spl[i_curr] );    epl_obs.push_back( f_curr.epl[i_curr] );
+    le_obs.push_back( f_curr.le[i_curr] );
+    inlier.push_back( true );
+}
+
+void LineMatches::computeCovariances( double f, double cx, double cy )
+{
+    covS.resize( size() );
+    covE.resize( size() );
+    for( int i = 0; i < size(); i++ )
+    {
+        covS[i] = backProjectionCov( spl[i], sdisp[i], f, cx, cy );
+        covE[i] = backProjectionCov( epl[i], edisp[i], f, cx, cy );
+    }
+}
 
 }
@@ -23,12 +23,70 @@
 
 namespace StVO{
 
-StereoFrame::StereoFrame(){}
+StereoFrame::StereoFrame() : fext_l(NULL), fext_r(NULL), own_fext(false), ldesc_l_indexed(false)
+{
+    initMotion();
+}
 
 StereoFrame::StereoFrame(const Mat img_l_, const Mat img_r_ , const int idx_, PinholeStereoCamera *cam_) :
-    img_l(img_l_), img_r(img_r_), frame_idx(idx_), cam(cam_) {}
+    img_l(img_l_), img_r(img_r_), frame_idx(idx_), cam(cam_), fext_l(NULL), fext_r(NULL), own_fext(false), ldesc_l_indexed(false)
+{
+    initMotion();
+}
+
+StereoFrame::StereoFrame(const Mat img_l_, const Mat img_r_ , const int idx_, PinholeStereoCamera *cam_, FeatureExtractor *fext_l_, FeatureExtractor *fext_r_) :
+    img_l(img_l_), img_r(img_r_), frame_idx(idx_), cam(cam_), fext_l(fext_l_), fext_r(fext_r_), own_fext(false), ldesc_l_indexed(false)
+{
+    initMotion();
+}
+
+StereoFrame::~StereoFrame()
+{
+    if( own_fext )
+    {
+        delete fext_l;
+        delete fext_r;
+    }
+}
+
+void StereoFrame::reset(const Mat img_l_, const Mat img_r_ , const int idx_)
+{
+    // recycle the frame for a new stereo pair, keeping the capacity of its feature arrays
+    img_l     = img_l_;
+    img_r     = img_r_;
+    frame_idx = idx_;
+    initMotion();
+    stereo_pt.clear();
+    stereo_ls.clear();
+    pdesc_l.release();
+    pdesc_r.release();
+    ldesc_l.release();
+    ldesc_r.release();
+    if( ldesc_l_index )
+        ldesc_l_index->clear();
+    ldesc_l_indexed = false;
+}
 
-StereoFrame::~StereoFrame(){}
+void StereoFrame::initMotion()
+{
+    // no motion estimate yet (err_norm < 0, as for a failed optimization)
+    Tfw        = SE3();
+    DT         = SE3();
+    DT_cov     = Matrix6d::Zero();
+    DT_cov_eig = Vector6d::Zero();
+    err_norm   = -1.0;
+}
+
+void StereoFrame::setupExtractors()
+{
+    // frames created without a handler-owned context get a private one
+    if( fext_l == NULL || fext_r == NULL )
+    {
+        fext_l   = new FeatureExtractor();
+        fext_r   = new FeatureExtractor();
+        own_fext = true;
+    }
+}
 
 void StereoFrame::extractInitialStereoFeatures()
 {
@@ -37,69 +95,71 @@ void StereoFrame::extractInitialStereoFeatures()
     vector<KeyPoint> points_l, points_r;
     vector<KeyLine>  lines_l, lines_r;
     double min_line_length_th = Config::minLineLength() * std::min( cam->getWidth(), cam->getHeight() );
+    setupExtractors();
     if( Config::lrInParallel() )
     {
-        auto detect_l = async(launch::async, &StereoFrame::detectFeatures, this, img_l, ref(points_l), ref(pdesc_l), ref(lines_l), ref(ldesc_l), min_line_length_th );
-        auto detect_r = async(launch::async, &StereoFrame::detectFeatures, this, img_r, ref(points_r), ref(pdesc_r), ref(lines_r), ref(ldesc_r), min_line_length_th );
-        detect_l.wait();
-        detect_r.wait();
+        auto detect_l = ThreadPool::getInstance().submit( &StereoFrame::detectFeatures, this, fext_l, img_l, ref(points_l), ref(pdesc_l), ref(lines_l), ref(ldesc_l), min_line_length_th );
+        auto detect_r = ThreadPool::getInstance().submit( &StereoFrame::detectFeatures, this, fext_r, img_r, ref(points_r), ref(pdesc_r), ref(lines_r), ref(ldesc_r), min_line_length_th );
+        ThreadPool::getInstance().wait( detect_l );
+        ThreadPool::getInstance().wait( detect_r );
     }
     else
     {
-        detectFeatures(img_l,points_l,pdesc_l,lines_l,ldesc_l,min_line_length_th);
-        detectFeatures(img_r,points_r,pdesc_r,lines_r,ldesc_r,min_line_length_th);
+        detectFeatures(fext_l,img_l,points_l,pdesc_l,lines_l,ldesc_l,min_line_length_th);
+        detectFeatures(fext_r,img_r,points_r,pdesc_r,lines_r,ldesc_r,min_line_length_th);
     }
 
     // Points stereo matching
     if( Config::hasPoints() && !(points_l.size()==0) && !(points_r.size()==0) )
     {
-        BFMatcher* bfm = new BFMatcher( NORM_HAMMING, false );
-        vector<vector<DMatch>> pmatches_lr, pmatches_rl, pmatches_lr_;
+        BFMatcher bfm( NORM_HAMMING, false );
+        KnnMatches pmatches_lr, pmatches_rl;
         Mat pdesc_l_;
         stereo_pt.clear();
         // LR and RL matches
-        if( Config::bestLRMatches() )
+        if( Config::epipolarSearch() && Config::simdMatching() && HammingMatcher::supports( pdesc_l, pdesc_r ) )
+            matchPointsInBand( points_l, points_r, pmatches_lr, pmatches_rl );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( pdesc_l, pdesc_r ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( pdesc_l, pdesc_r, pmatches_lr, pmatches_rl );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrame::matchPointFeatures, this, bfm, pdesc_l, pdesc_r, ref(pmatches_lr) );
-                auto match_r = async( launch::async, &StereoFrame::matchPointFeatures, this, bfm, pdesc_r, pdesc_l, ref(pmatches_rl) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrame::matchPointFeatures, this, &bfm, pdesc_l, pdesc_r, ref(pmatches_lr) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrame::matchPointFeatures, this, &bfm, pdesc_r, pdesc_l, ref(pmatches_rl) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bfm->knnMatch( pdesc_l, pdesc_r, pmatches_lr, 2);
-                bfm->knnMatch( pdesc_r, pdesc_l, pmatches_rl, 2);
+                matchPointFeatures( &bfm, pdesc_l, pdesc_r, pmatches_lr );
+                matchPointFeatures( &bfm, pdesc_r, pdesc_l, pmatches_rl );
             }
         }
         else
-            bfm->knnMatch( pdesc_l, pdesc_r, pmatches_lr, 2);
+            matchPointFeatures( &bfm, pdesc_l, pdesc_r, pmatches_lr );
 
         // sort matches by the distance between the best and second best matches
         double nn12_dist_th  = Config::minRatio12P();
 
-        // resort according to the queryIdx
-        sort( pmatches_lr.begin(), pmatches_lr.end(), sort_descriptor_by_queryIdx() );
-        if(Config::bestLRMatches())
-            sort( pmatches_rl.begin(), pmatches_rl.end(), sort_descriptor_by_queryIdx() );
-
         // bucle around pmatches
         int pt_idx = 0;
-        for( int i = 0; i < pmatches_lr.size(); i++ )
+        for( int lr_qdx = 0; lr_qdx < pmatches_lr.size(); lr_qdx++ )
         {
-            int lr_qdx, lr_tdx, rl_tdx;
-            lr_qdx = pmatches_lr[i][0].queryIdx;
-            lr_tdx = pmatches_lr[i][0].trainIdx;
+            // matches are indexed by queryIdx, skip the points without candidates
+            int lr_tdx, rl_tdx;
+            lr_tdx = pmatches_lr[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             if( Config::bestLRMatches() )
             {
                 // check if they are mutual best matches
-                rl_tdx = pmatches_rl[lr_tdx][0].trainIdx;
+                rl_tdx = pmatches_rl[lr_tdx].trainIdx[0];
             }
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_12 = pmatches_lr[i][0].distance / pmatches_lr[i][1].distance;
+            double dist_12 = double(pmatches_lr[lr_qdx].distance[0]) / double(pmatches_lr[lr_qdx].distance[1]);
             if( lr_qdx == rl_tdx  && dist_12 > nn12_dist_th )
             {
                 // check stereo epipolar constraint
@@ -109,10 +169,9 @@ void StereoFrame::extractInitialStereoFeatures()
                     double disp_ = points_l[lr_qdx].pt.x - points_r[lr_tdx].pt.x;
                     if( disp_ >= Config::minDisp() ){
                         pdesc_l_.push_back( pdesc_l.row(lr_qdx) );
-                        PointFeature* point_;
                         Vector2d pl_; pl_ << points_l[lr_qdx].pt.x, points_l[lr_qdx].pt.y;
                         Vector3d P_;  P_ = cam->backProjection( pl_(0), pl_(1), disp_);
-                        stereo_pt.push_back( new PointFeature(pl_,disp_,P_,pt_idx) );
+                        stereo_pt.push_back( pl_, disp_, P_, pt_idx );
                         pt_idx++;
                     }
                 }
@@ -127,56 +186,51 @@ void StereoFrame::extractInitialStereoFeatures()
     {
         stereo_ls.clear();
         Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
-        vector<vector<DMatch>> lmatches_lr, lmatches_rl;
+        KnnMatches lmatches_lr, lmatches_rl;
         Mat ldesc_l_;
         // LR and RL matches
-        if( Config::bestLRMatches() )
+        if( Config::epipolarSearch() && Config::simdMatching() && HammingMatcher::supports( ldesc_l, ldesc_r ) )
+            matchLinesInBand( lines_l, lines_r, lmatches_lr, lmatches_rl );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( ldesc_l, ldesc_r ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( ldesc_l, ldesc_r, lmatches_lr, lmatches_rl );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrame::matchLineFeatures, this, bdm, ldesc_l, ldesc_r, ref(lmatches_lr) );
-                auto match_r = async( launch::async, &StereoFrame::matchLineFeatures, this, bdm, ldesc_r, ldesc_l, ref(lmatches_rl) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrame::matchLineFeatures, this, bdm, ldesc_l, ldesc_r, ref(lmatches_lr) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrame::matchLineFeatures, this, bdm, ldesc_r, ldesc_l, ref(lmatches_rl) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bdm->knnMatch( ldesc_l,ldesc_r, lmatches_lr, 2);
-                bdm->knnMatch( ldesc_r,ldesc_l, lmatches_rl, 2);
+                matchLineFeatures( bdm, ldesc_l, ldesc_r, lmatches_lr );
+                matchLineFeatures( bdm, ldesc_r, ldesc_l, lmatches_rl );
             }
         }
         else
-            bdm->knnMatch( ldesc_l,ldesc_r, lmatches_lr, 2);
+            matchLineFeatures( bdm, ldesc_l, ldesc_r, lmatches_lr );
 
         // // sort matches by the distance between the best and second best matches
         double nn_dist_th, nn12_dist_th;
         lineDescriptorMAD(lmatches_lr,nn_dist_th, nn12_dist_th);        
         nn12_dist_th  = nn12_dist_th * Config::descThL();
 
-        // bucle around pmatches
-        sort( lmatches_lr.begin(), lmatches_lr.end(), sort_descriptor_by_queryIdx() );
-        if( Config::bestLRMatches() )
-            sort( lmatches_rl.begin(), lmatches_rl.end(), sort_descriptor_by_queryIdx() );
-
-        int n_matches;
-        if( Config::bestLRMatches() )
-            n_matches = min(lmatches_lr.size(),lmatches_rl.size());
-        else
-            n_matches = lmatches_lr.size();
-
+        // bucle around lmatches
         int ls_idx = 0;
-        for( int i = 0; i < n_matches; i++ )
+        for( int lr_qdx = 0; lr_qdx < lmatches_lr.size(); lr_qdx++ )
         {
-            // check if they are mutual best matches ( if bestLRMatches() )
-            int lr_qdx = lmatches_lr[i][0].queryIdx;
-            int lr_tdx = lmatches_lr[i][0].trainIdx;
+            // check if they are mutual best matches ( if bestLRMatches() ), skip the lines without candidates
+            int lr_tdx = lmatches_lr[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             int rl_tdx;
             if( Config::bestLRMatches() )
-                rl_tdx = lmatches_rl[lr_tdx][0].trainIdx;
+                rl_tdx = lmatches_rl[lr_tdx].trainIdx[0];
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_12 = lmatches_lr[i][1].distance - lmatches_lr[i][0].distance;
+            double dist_12 = lmatches_lr[lr_qdx].distance[1] - lmatches_lr[lr_qdx].distance[0];
             double length  = lines_r[lr_tdx].lineLength;
 
             if( lr_qdx == rl_tdx && length > min_line_length_th && dist_12 > nn12_dist_th )
@@ -202,7 +256,7 @@ void StereoFrame::extractInitialStereoFeatures()
                         Vector3d sP_; sP_ = cam->backProjection( sp_l(0), sp_l(1), disp_s);
                         Vector3d eP_; eP_ = cam->backProjection( ep_l(0), ep_l(1), disp_e);
                         double angle_l = lines_l[lr_qdx].angle;
-                        stereo_ls.push_back( new LineFeature(Vector2d(sp_l(0),sp_l(1)),disp_s,sP_,Vector2d(ep_l(0),ep_l(1)),disp_e,eP_,le_l,angle_l,ls_idx) );
+                        stereo_ls.push_back( Vector2d(sp_l(0),sp_l(1)), disp_s, sP_, Vector2d(ep_l(0),ep_l(1)), disp_e, eP_, le_l, angle_l, ls_idx );
                         ls_idx++;
                     }
                 }
@@ -221,68 +275,70 @@ void StereoFrame::extractStereoFeatures()
     vector<KeyPoint> points_l, points_r;
     vector<KeyLine>  lines_l, lines_r;
     double min_line_length_th = Config::minLineLength() * std::min( cam->getWidth(), cam->getHeight() ) ;
+    setupExtractors();
     if( Config::lrInParallel() )
     {
-        auto detect_l = async(launch::async, &StereoFrame::detectFeatures, this, img_l, ref(points_l), ref(pdesc_l), ref(lines_l), ref(ldesc_l), min_line_length_th );
-        auto detect_r = async(launch::async, &StereoFrame::detectFeatures, this, img_r, ref(points_r), ref(pdesc_r), ref(lines_r), ref(ldesc_r), min_line_length_th );
-        detect_l.wait();
-        detect_r.wait();
+        auto detect_l = ThreadPool::getInstance().submit( &StereoFrame::detectFeatures, this, fext_l, img_l, ref(points_l), ref(pdesc_l), ref(lines_l), ref(ldesc_l), min_line_length_th );
+        auto detect_r = ThreadPool::getInstance().submit( &StereoFrame::detectFeatures, this, fext_r, img_r, ref(points_r), ref(pdesc_r), ref(lines_r), ref(ldesc_r), min_line_length_th );
+        ThreadPool::getInstance().wait( detect_l );
+        ThreadPool::getInstance().wait( detect_r );
     }
     else
     {
-        detectFeatures(img_l,points_l,pdesc_l,lines_l,ldesc_l,min_line_length_th);
-        detectFeatures(img_r,points_r,pdesc_r,lines_r,ldesc_r,min_line_length_th);
+        detectFeatures(fext_l,img_l,points_l,pdesc_l,lines_l,ldesc_l,min_line_length_th);
+        detectFeatures(fext_r,img_r,points_r,pdesc_r,lines_r,ldesc_r,min_line_length_th);
     }
 
     // Points stereo matching
     if( Config::hasPoints() && !(points_l.size()==0) && !(points_r.size()==0) )
     {
-        BFMatcher* bfm = new BFMatcher( NORM_HAMMING, false );
-        vector<vector<DMatch>> pmatches_lr, pmatches_rl, pmatches_lr_;
+        BFMatcher bfm( NORM_HAMMING, false );
+        KnnMatches pmatches_lr, pmatches_rl;
         Mat pdesc_l_;
         stereo_pt.clear();
         // LR and RL matches
-        if( Config::bestLRMatches() )
+        if( Config::epipolarSearch() && Config::simdMatching() && HammingMatcher::supports( pdesc_l, pdesc_r ) )
+            matchPointsInBand( points_l, points_r, pmatches_lr, pmatches_rl );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( pdesc_l, pdesc_r ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( pdesc_l, pdesc_r, pmatches_lr, pmatches_rl );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrame::matchPointFeatures, this, bfm, pdesc_l, pdesc_r, ref(pmatches_lr) );
-                auto match_r = async( launch::async, &StereoFrame::matchPointFeatures, this, bfm, pdesc_r, pdesc_l, ref(pmatches_rl) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrame::matchPointFeatures, this, &bfm, pdesc_l, pdesc_r, ref(pmatches_lr) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrame::matchPointFeatures, this, &bfm, pdesc_r, pdesc_l, ref(pmatches_rl) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bfm->knnMatch( pdesc_l, pdesc_r, pmatches_lr, 2);
-                bfm->knnMatch( pdesc_r, pdesc_l, pmatches_rl, 2);
+                matchPointFeatures( &bfm, pdesc_l, pdesc_r, pmatches_lr );
+                matchPointFeatures( &bfm, pdesc_r, pdesc_l, pmatches_rl );
             }
         }
         else
-            bfm->knnMatch( pdesc_l, pdesc_r, pmatches_lr, 2);
+            matchPointFeatures( &bfm, pdesc_l, pdesc_r, pmatches_lr );
 
         // sort matches by the distance between the best and second best matches
         double nn12_dist_th  = Config::minRatio12P();
 
-        // resort according to the queryIdx
-        sort( pmatches_lr.begin(), pmatches_lr.end(), sort_descriptor_by_queryIdx() );
-        if(Config::bestLRMatches())
-            sort( pmatches_rl.begin(), pmatches_rl.end(), sort_descriptor_by_queryIdx() );
-
         // bucle around pmatches
-        for( int i = 0; i < pmatches_lr.size(); i++ )
+        for( int lr_qdx = 0; lr_qdx < pmatches_lr.size(); lr_qdx++ )
         {
-            int lr_qdx, lr_tdx, rl_tdx;
-            lr_qdx = pmatches_lr[i][0].queryIdx;
-            lr_tdx = pmatches_lr[i][0].trainIdx;
+            // matches are indexed by queryIdx, skip the points without candidates
+            int lr_tdx, rl_tdx;
+            lr_tdx = pmatches_lr[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             if( Config::bestLRMatches() )
             {
                 // check if they are mutual best matches
-                rl_tdx = pmatches_rl[lr_tdx][0].trainIdx;
+                rl_tdx = pmatches_rl[lr_tdx].trainIdx[0];
             }
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_12 = pmatches_lr[i][0].distance / pmatches_lr[i][1].distance;
+            double dist_12 = double(pmatches_lr[lr_qdx].distance[0]) / double(pmatches_lr[lr_qdx].distance[1]);
             if( lr_qdx == rl_tdx  && dist_12 > nn12_dist_th )
             {
                 // check stereo epipolar constraint
@@ -292,10 +348,9 @@ void StereoFrame::extractStereoFeatures()
                     double disp_ = points_l[lr_qdx].pt.x - points_r[lr_tdx].pt.x;
                     if( disp_ >= Config::minDisp() ){
                         pdesc_l_.push_back( pdesc_l.row(lr_qdx) );
-                        PointFeature* point_;
                         Vector2d pl_; pl_ << points_l[lr_qdx].pt.x, points_l[lr_qdx].pt.y;
                         Vector3d P_;  P_ = cam->backProjection( pl_(0), pl_(1), disp_);
-                        stereo_pt.push_back( new PointFeature(pl_,disp_,P_,-1) );
+                        stereo_pt.push_back( pl_, disp_, P_, -1 );
                     }
                 }
             }
@@ -311,55 +366,50 @@ void StereoFrame::extractStereoFeatures()
     {
         stereo_ls.clear();
         Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
-        vector<vector<DMatch>> lmatches_lr, lmatches_rl;
+        KnnMatches lmatches_lr, lmatches_rl;
         Mat ldesc_l_;
         // LR and RL matches
-        if( Config::bestLRMatches() )
+        if( Config::epipolarSearch() && Config::simdMatching() && HammingMatcher::supports( ldesc_l, ldesc_r ) )
+            matchLinesInBand( lines_l, lines_r, lmatches_lr, lmatches_rl );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( ldesc_l, ldesc_r ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( ldesc_l, ldesc_r, lmatches_lr, lmatches_rl );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrame::matchLineFeatures, this, bdm, ldesc_l, ldesc_r, ref(lmatches_lr) );
-                auto match_r = async( launch::async, &StereoFrame::matchLineFeatures, this, bdm, ldesc_r, ldesc_l, ref(lmatches_rl) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrame::matchLineFeatures, this, bdm, ldesc_l, ldesc_r, ref(lmatches_lr) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrame::matchLineFeatures, this, bdm, ldesc_r, ldesc_l, ref(lmatches_rl) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bdm->knnMatch( ldesc_l,ldesc_r, lmatches_lr, 2);
-                bdm->knnMatch( ldesc_r,ldesc_l, lmatches_rl, 2);
+                matchLineFeatures( bdm, ldesc_l, ldesc_r, lmatches_lr );
+                matchLineFeatures( bdm, ldesc_r, ldesc_l, lmatches_rl );
             }
         }
         else
-            bdm->knnMatch( ldesc_l,ldesc_r, lmatches_lr, 2);
+            matchLineFeatures( bdm, ldesc_l, ldesc_r, lmatches_lr );
 
         // sort matches by the distance between the best and second best matches
         double nn_dist_th, nn12_dist_th;
         lineDescriptorMAD(lmatches_lr,nn_dist_th, nn12_dist_th);
         nn12_dist_th  = nn12_dist_th * Config::descThL();
 
-        // bucle around pmatches
-        sort( lmatches_lr.begin(), lmatches_lr.end(), sort_descriptor_by_queryIdx() );
-        if( Config::bestLRMatches() )
-            sort( lmatches_rl.begin(), lmatches_rl.end(), sort_descriptor_by_queryIdx() );
-
-        int n_matches;
-        if( Config::bestLRMatches() )
-            n_matches = min(lmatches_lr.size(),lmatches_rl.size());
-        else
-            n_matches = lmatches_lr.size();
-
-        for( int i = 0; i < n_matches; i++ )
+        // bucle around lmatches
+        for( int lr_qdx = 0; lr_qdx < lmatches_lr.size(); lr_qdx++ )
         {
-            // check if they are mutual best matches ( if bestLRMatches() )
-            int lr_qdx = lmatches_lr[i][0].queryIdx;
-            int lr_tdx = lmatches_lr[i][0].trainIdx;
+            // check if they are mutual best matches ( if bestLRMatches() ), skip the lines without candidates
+            int lr_tdx = lmatches_lr[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             int rl_tdx;
             if( Config::bestLRMatches() )
-                rl_tdx = lmatches_rl[lr_tdx][0].trainIdx;
+                rl_tdx = lmatches_rl[lr_tdx].trainIdx[0];
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_12 = lmatches_lr[i][1].distance - lmatches_lr[i][0].distance;
+            double dist_12 = lmatches_lr[lr_qdx].distance[1] - lmatches_lr[lr_qdx].distance[0];
             double length  = lines_r[lr_tdx].lineLength;
 
             if( lr_qdx == rl_tdx && length > min_line_length_th && dist_12 > nn12_dist_th )
@@ -385,7 +435,7 @@ void StereoFrame::extractStereoFeatures()
                         Vector3d sP_; sP_ = cam->backProjection( sp_l(0), sp_l(1), disp_s);
                         Vector3d eP_; eP_ = cam->backProjection( ep_l(0), ep_l(1), disp_e);
                         double angle_l = lines_l[lr_qdx].angle;
-                        stereo_ls.push_back( new LineFeature(Vector2d(sp_l(0),sp_l(1)),disp_s,sP_,Vector2d(ep_l(0),ep_l(1)),disp_e,eP_,le_l,angle_l,-1) );
+                        stereo_ls.push_back( Vector2d(sp_l(0),sp_l(1)), disp_s, sP_, Vector2d(ep_l(0),ep_l(1)), disp_e, eP_, le_l, angle_l, -1 );
                     }
                 }
             }
@@ -396,152 +446,106 @@ void StereoFrame::extractStereoFeatures()
 
 }
 
-void StereoFrame::detectFeatures(Mat img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length)
+Ptr<BinaryDescriptorMatcher> StereoFrame::lineIndex()
 {
+    // built on first use, once ldesc_l only keeps the stereo matched lines (the matcher is kept across resets)
+    if( !ldesc_l_indexed )
+    {
+        if( !ldesc_l_index )
+            ldesc_l_index = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+        ldesc_l_index->add( vector<Mat>( 1, ldesc_l ) );
+        ldesc_l_index->train();
+        ldesc_l_indexed = true;
+    }
+    return ldesc_l_index;
+}
 
-    // Declare objects
-    Ptr<BinaryDescriptor>   lbd = BinaryDescriptor::createBinaryDescriptor();
-    Ptr<ORB>                orb = ORB::create( Config::orbNFeatures(), Config::orbScaleFactor(), Config::orbNLevels() );
-
-    // Detect point features
-    if( Config::hasPoints() )
-        orb->detectAndCompute( img, Mat(), points, pdesc, false);
+void StereoFrame::detectFeatures(FeatureExtractor* fext, Mat img, vector<KeyPoint> &points, Mat &pdesc, vector<KeyLine> &lines, Mat &ldesc, double min_line_length)
+{
+    fext->detectFeatures( img, points, pdesc, lines, ldesc, min_line_length );
+}
 
-    // Detect line features
-    lines.clear();
-    if( Config::hasLines() )
+void StereoFrame::matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12  )
+{
+    if( Config::simdMatching() && HammingMatcher::supports( pdesc_1, pdesc_2 ) )
+        HammingMatcher::knnMatch( pdesc_1, pdesc_2, pmatches_12 );
+    else
     {
-        if( Config::useEDLines() )
-        {
-            // EDLines parameters
-            BinaryDescriptor::EDLineParam opts;
-            opts.ksize               = Config::edlKsize();
-            opts.sigma               = Config::edlSigma();
-            opts.gradientThreshold   = Config::edlGradientTh();
-            opts.anchorThreshold     = Config::edlAnchorTh();
-            opts.scanIntervals       = Config::edlScanInterv();
-            opts.minLineLen          = Config::edlMinLineLen();
-            opts.lineFitErrThreshold = Config::edlFitErrTh();
-
-            BinaryDescriptor::EDLineDetector* edl = new BinaryDescriptor::EDLineDetector(opts);
-            BinaryDescriptor::LineChains lines_;
-
-            edl->EDline(img,lines_);
-            int idx_aux = 0;
-            for(int i = 0; i < edl->lineEndpoints_.size(); i++)
-            {
-                KeyLine l_;
-                // estimate endpoints from LineChains
-                int s_idx = lines_.sId[i];
-                int e_idx = lines_.sId[i+1] - 1;
-                float sx  = edl->lineEndpoints_[i][0];
-                float sy  = edl->lineEndpoints_[i][1];
-                float ex  = edl->lineEndpoints_[i][2];
-                float ey  = edl->lineEndpoints_[i][3];
-                double line_length = sqrt( double( pow(ex-sx,2) + pow(ey-sy,2) ) );
-
-                // create keyline
-                if( line_length > min_line_length )
-                {
-                    l_.angle       = edl->lineDirection_[i];
-                    l_.startPointX = sx;    l_.sPointInOctaveX = sx;
-                    l_.startPointY = sy;    l_.sPointInOctaveY = sy;
-                    l_.endPointX   = ex;    l_.ePointInOctaveX = ex;
-                    l_.endPointY   = ey;    l_.ePointInOctaveY = ey;
-                    l_.lineLength  = line_length;
-                    l_.octave      = 0;
-                    l_.class_id    = idx_aux;
-                    l_.numOfPixels = e_idx - s_idx;
-                    l_.response    = line_length / double(max( img_l.cols, img_l.rows ));
-                    lines.push_back(l_);
-                    idx_aux++;
-                }
-            }
-            lbd->compute( img, lines, ldesc);
-        }
-        else
-        {
-            Ptr<LSDDetector>        lsd = LSDDetector::createLSDDetector();
-            // lsd parameters
-            LSDDetector::LSDOptions opts;
-            opts.refine       = Config::lsdRefine();
-            opts.scale        = Config::lsdScale();
-            opts.sigma_scale  = Config::lsdSigmaScale();
-            opts.quant        = Config::lsdQuant();
-            opts.ang_th       = Config::lsdAngTh();
-            opts.log_eps      = Config::lsdLogEps();
-            opts.density_th   = Config::lsdDensityTh();
-            opts.n_bins       = Config::lsdNBins();
-            opts.min_length   = min_line_length;
-
-            lsd->detect( img, lines, 1, 1, opts);
-            lbd->compute( img, lines, ldesc);
-        }
+        vector<vector<DMatch>> pmatches_;
+        bfm->knnMatch( pdesc_1, pdesc_2, pmatches_, 2);
+        toKnnMatches( pmatches_, pdesc_1.rows, 8 * pdesc_2.cols, pmatches_12 );
     }
+}
 
+void StereoFrame::matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, KnnMatches &lmatches_12  )
+{
+    if( Config::simdMatching() && HammingMatcher::supports( ldesc_1, ldesc_2 ) )
+        HammingMatcher::knnMatch( ldesc_1, ldesc_2, lmatches_12 );
+    else
+    {
+        vector<vector<DMatch>> lmatches_;
+        bdm->knnMatch( ldesc_1, ldesc_2, lmatches_, 2);
+        toKnnMatches( lmatches_, ldesc_1.rows, 8 * ldesc_2.cols, lmatches_12 );
+    }
 }
 
-void StereoFrame::matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, vector<vector<DMatch>> &pmatches_12  )
+void StereoFrame::matchPointsInBand( const vector<KeyPoint> &points_l, const vector<KeyPoint> &points_r, KnnMatches &pmatches_lr, KnnMatches &pmatches_rl )
 {
-    bfm->knnMatch( pdesc_1, pdesc_2, pmatches_12, 2);
+    // only right points within the epipolar band and with a valid disparity are compared
+    EpipolarIndex epi_r;
+    vector<int> offsets, cand;
+    epi_r.setPoints( points_r, Config::maxDistEpip() );
+    epi_r.pointCandidates( points_l, Config::minDisp(), offsets, cand );
+    MatcherCostModel::adaptiveCrossCheckMatch( pdesc_l, pdesc_r, offsets, cand, pmatches_lr, pmatches_rl );
 }
 
-void StereoFrame::matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, vector<vector<DMatch>> &lmatches_12  )
+void StereoFrame::matchLinesInBand( const vector<KeyLine> &lines_l, const vector<KeyLine> &lines_r, KnnMatches &lmatches_lr, KnnMatches &lmatches_rl )
 {
-    bdm->knnMatch( ldesc_1, ldesc_2, lmatches_12, 2);
+    // only right lines overlapping the same rows, with similar angle and valid disparities are compared
+    EpipolarIndex epi_r;
+    vector<int> offsets, cand;
+    epi_r.setLines( lines_r, Config::maxDistEpip() );
+    epi_r.lineCandidates( lines_l, Config::minDisp(), Config::minHorizAngle(), Config::maxAngleDiff(), offsets, cand );
+    MatcherCostModel::adaptiveCrossCheckMatch( ldesc_l, ldesc_r, offsets, cand, lmatches_lr, lmatches_rl );
 }
 
-void StereoFrame::pointDescriptorMAD( const vector<vector<DMatch>> matches, double &nn_mad, double &nn12_mad )
+void StereoFrame::pointDescriptorMAD( const KnnMatches &matches, double &nn_mad, double &nn12_mad )
 {
 
-    vector<vector<DMatch>> matches_nn, matches_12;
-    matches_nn = matches;
-    matches_12 = matches;
-
-    // estimate the NN's distance standard deviation
-    double nn_dist_median;
-    sort( matches_nn.begin(), matches_nn.end(), compare_descriptor_by_NN_dist() );
-    nn_mad = matches_nn[int(matches_nn.size()/2)][0].distance;
-    for( int j = 0; j < matches_nn.size(); j++)
-        matches_nn[j][0].distance = fabsf( matches_nn[j][0].distance - nn_dist_median );
-    sort( matches_nn.begin(), matches_nn.end(), compare_descriptor_by_NN_dist() );
-    nn_mad = 1.4826 * matches_nn[int(matches_nn.size()/2)][0].distance;
-
-    // estimate the NN's 12 distance standard deviation
-    double nn12_dist_median;
-    sort( matches_12.begin(), matches_12.end(), compare_descriptor_by_NN12_ratio() );
-    nn_dist_median = matches_12[int(matches_12.size()/2)][0].distance / matches_12[int(matches_12.size()/2)][1].distance;
-    for( int j = 0; j < matches_12.size(); j++)
-        matches_12[j][0].distance = fabsf( matches_12[j][0].distance / matches_12[j][1].distance - nn_dist_median );
-    sort( matches_12.begin(), matches_12.end(), compare_descriptor_by_NN_dist() );
-    nn12_mad =  1.4826 * matches_12[int(matches_12.size()/2)][0].distance;
+    // distances of the queries with a match
+    vector<int>    nn_dist;
+    vector<double> nn12_ratio;
+    for( int i = 0; i < matches.size(); i++ )
+    {
+        if( matches[i].trainIdx[0] < 0 )
+            continue;
+        nn_dist.push_back( matches[i].distance[0] );
+        nn12_ratio.push_back( double(matches[i].distance[0]) / double(matches[i].distance[1]) );
+    }
+
+    // NN's distance and NN12 ratio standard deviations (Hamming distances are at most 256)
+    nn_mad   = stdvMADHistogram( nn_dist, 256 );
+    nn12_mad = stdvMADSelect( nn12_ratio );
 
 }
 
-void StereoFrame::lineDescriptorMAD( const vector<vector<DMatch>> matches, double &nn_mad, double &nn12_mad )
+void StereoFrame::lineDescriptorMAD( const KnnMatches &matches, double &nn_mad, double &nn12_mad )
 {
 
-    vector<vector<DMatch>> matches_nn, matches_12;
-    matches_nn = matches;
-    matches_12 = matches;
-
-    // estimate the NN's distance standard deviation
-    double nn_dist_median;
-    sort( matches_nn.begin(), matches_nn.end(), compare_descriptor_by_NN_dist() );
-    nn_mad = matches_nn[int(matches_nn.size()/2)][0].distance;
-    for( int j = 0; j < matches_nn.size(); j++)
-        matches_nn[j][0].distance = fabsf( matches_nn[j][0].distance - nn_dist_median );
-    sort( matches_nn.begin(), matches_nn.end(), compare_descriptor_by_NN_dist() );
-    nn_mad = 1.4826 * matches_nn[int(matches_nn.size()/2)][0].distance;
-
-    // estimate the NN's 12 distance standard deviation
-    double nn12_dist_median;
-    sort( matches_12.begin(), matches_12.end(), compare_descriptor_by_NN12_dist() );
-    nn12_mad = matches_12[int(matches_12.size()/2)][1].distance - matches_12[int(matches_12.size()/2)][0].distance;
-    for( int j = 0; j < matches_12.size(); j++)
-        matches_12[j][0].distance = fabsf( matches_12[j][1].distance - matches_12[j][0].distance - nn_dist_median );
-    sort( matches_12.begin(), matches_12.end(), compare_descriptor_by_NN_dist() );
-    nn12_mad =  1.4826 * matches_12[int(matches_12.size()/2)][0].distance;
+    // distances of the queries with a match
+    vector<int> nn_dist, nn12_dist;
+    for( int i = 0; i < matches.size(); i++ )
+    {
+        if( matches[i].trainIdx[0] < 0 )
+            continue;
+        nn_dist.push_back( matches[i].distance[0] );
+        nn12_dist.push_back( matches[i].distance[1] - matches[i].distance[0] );
+    }
+
+    // NN's distance and NN12 distance standard deviations (Hamming distances are at most 256),
+    // both 0 without matches (e.g. no candidates within the epipolar band)
+    nn_mad   = stdvMADHistogram( nn_dist, 256 );
+    nn12_mad = stdvMADHistogram( nn12_dist, 256 );
 
 }
 
@@ -21,17 +21,80 @@
 
 #include <stereoFrameHandler.h>
 
+#include <cfloat>
+
 namespace StVO{
 
-StereoFrameHandler::StereoFrameHandler( PinholeStereoCamera *cam_ ) : cam(cam_) {}
+StereoFrameHandler::StereoFrameHandler( PinholeStereoCamera *cam_ ) :
+    prev_keyframe(NULL), prev_frame(NULL), curr_frame(NULL), cam(cam_)
+{
+    // fixed ring of frames (previous keyframe, previous and current, plus the prefetched ones),
+    // recycled along the sequence; each frame owns its feature extractors, since up to
+    // Config::pipelineDepth() extractions run at the same time
+    int ring_size = 3 + std::max( 0, Config::pipelineDepth() );
+    for( int k = 0; k < ring_size; k++ )
+        frame_ring.push_back( new StereoFrame( Mat(), Mat(), -1, cam ) );
+}
+
+StereoFrameHandler::~StereoFrameHandler()
+{
+    drainPendingFrames();
+    for( int k = 0; k < frame_ring.size(); k++ )
+        delete frame_ring[k];
+}
+
+StereoFrame* StereoFrameHandler::nextFrame(const Mat img_l_, const Mat img_r_ , const int idx_)
+{
+    // first slot not referenced by the handler
+    for( int k = 0; k < frame_ring.size(); k++ )
+    {
+        StereoFrame* frame_ = frame_ring[k];
+        bool pending = false;
+        for( int j = 0; j < pending_frames.size(); j++ )
+            pending = pending || pending_frames[j].frame == frame_;
+        if( frame_ != prev_keyframe && frame_ != prev_frame && frame_ != curr_frame && !pending )
+        {
+            frame_->reset( img_l_, img_r_, idx_ );
+            return frame_;
+        }
+    }
+    return NULL;
+}
+
+void StereoFrameHandler::drainPendingFrames()
+{
+    // the frames of the extractions in flight cannot be recycled
+    while( !pending_frames.empty() )
+    {
+        ThreadPool::getInstance().wait( pending_frames.front().extraction );
+        pending_frames.pop_front();
+    }
+}
 
-StereoFrameHandler::~StereoFrameHandler(){}
+bool StereoFrameHandler::prefetchStereoPair(const Mat img_l_, const Mat img_r_ , const int idx_)
+{
+    // the stereo features of a frame do not depend on the previous ones, so they can be extracted
+    // on the pool while the current pair is tracked and optimized
+    if( pending_frames.size() >= Config::pipelineDepth() )
+        return false;
+    PendingFrame next;
+    next.frame = nextFrame( img_l_, img_r_, idx_ );
+    if( next.frame == NULL )
+        return false;
+    next.extraction = ThreadPool::getInstance().submitBackground( &StereoFrame::extractStereoFeatures, next.frame );
+    pending_frames.push_back( move(next) );
+    return true;
+}
 
 void StereoFrameHandler::initialize(const Mat img_l_, const Mat img_r_ , const int idx_)
 {
-    prev_frame = new StereoFrame( img_l_, img_r_, idx_, cam );
+    drainPendingFrames();
+    prev_keyframe = NULL;
+    prev_frame    = NULL;
+    curr_frame    = NULL;
+    prev_frame = nextFrame( img_l_, img_r_, idx_ );
     prev_frame->extractInitialStereoFeatures();
-    prev_frame->Tfw = Matrix4d::Identity();
+    prev_frame->Tfw = SE3();
     max_idx_pt = prev_frame->stereo_pt.size();  max_idx_pt_prev_kf = max_idx_pt;
     max_idx_ls = prev_frame->stereo_ls.size();  max_idx_ls_prev_kf = max_idx_ls;
     prev_keyframe = prev_frame;
@@ -39,8 +102,19 @@ void StereoFrameHandler::initialize(const Mat img_l_, const Mat img_r_ , const i
 
 void StereoFrameHandler::insertStereoPair(const Mat img_l_, const Mat img_r_ , const int idx_)
 {
-    curr_frame = new StereoFrame( img_l_, img_r_, idx_, cam );
-    curr_frame->extractStereoFeatures();
+    // prefetched pairs come back in order
+    if( !pending_frames.empty() && pending_frames.front().frame->frame_idx == idx_ )
+    {
+        ThreadPool::getInstance().wait( pending_frames.front().extraction );
+        curr_frame = pending_frames.front().frame;
+        pending_frames.pop_front();
+    }
+    else
+    {
+        drainPendingFrames();
+        curr_frame = nextFrame( img_l_, img_r_, idx_ );
+        curr_frame->extractStereoFeatures();
+    }
     f2fTracking();
 }
 
@@ -51,68 +125,65 @@ void StereoFrameHandler::f2fTracking()
     matched_pt.clear();
     if( Config::hasPoints() && !(curr_frame->stereo_pt.size()==0) && !(prev_frame->stereo_pt.size()==0)  )
     {
-        BFMatcher* bfm = new BFMatcher( NORM_HAMMING, false );    // cross-check
+        BFMatcher bfm( NORM_HAMMING, false );    // cross-check
         Mat pdesc_l1, pdesc_l2;
-        vector<vector<DMatch>> pmatches_12, pmatches_21;
+        KnnMatches pmatches_12, pmatches_21;
         // 12 and 21 matches
         pdesc_l1 = prev_frame->pdesc_l;
         pdesc_l2 = curr_frame->pdesc_l;        
-        if( Config::bestLRMatches() )
+        if( Config::f2fGridSearch() && Config::simdMatching() && HammingMatcher::supports( pdesc_l1, pdesc_l2 ) )
+            matchPointsInWindow( pdesc_l1, pdesc_l2, pmatches_12, pmatches_21 );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( pdesc_l1, pdesc_l2 ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( pdesc_l1, pdesc_l2, pmatches_12, pmatches_21 );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrameHandler::matchPointFeatures, this, bfm, pdesc_l1, pdesc_l2, ref(pmatches_12) );
-                auto match_r = async( launch::async, &StereoFrameHandler::matchPointFeatures, this, bfm, pdesc_l2, pdesc_l1, ref(pmatches_21) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrameHandler::matchPointFeatures, this, &bfm, pdesc_l1, pdesc_l2, ref(pmatches_12) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrameHandler::matchPointFeatures, this, &bfm, pdesc_l2, pdesc_l1, ref(pmatches_21) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bfm->knnMatch( pdesc_l1, pdesc_l2, pmatches_12, 2);
-                bfm->knnMatch( pdesc_l2, pdesc_l1, pmatches_21, 2);
+                matchPointFeatures( &bfm, pdesc_l1, pdesc_l2, pmatches_12 );
+                matchPointFeatures( &bfm, pdesc_l2, pdesc_l1, pmatches_21 );
             }
         }
         else
-            bfm->knnMatch( pdesc_l1, pdesc_l2, pmatches_12, 2);
+            matchPointFeatures( &bfm, pdesc_l1, pdesc_l2, pmatches_12 );
 
         // sort matches by the distance between the best and second best matches
         double nn12_dist_th = Config::minRatio12P();
         double dispTh       = Config::maxF2FDisp() * cam->getWidth();
 
-        // resort according to the queryIdx
-        sort( pmatches_12.begin(), pmatches_12.end(), sort_descriptor_by_queryIdx() );
-        if( Config::bestLRMatches() )
-            sort( pmatches_21.begin(), pmatches_21.end(), sort_descriptor_by_queryIdx() );
-
-        // bucle around pmatches
-        for( int i = 0; i < pmatches_12.size(); i++ )
+        // bucle around pmatches (indexed by queryIdx)
+        for( int lr_qdx = 0; lr_qdx < pmatches_12.size(); lr_qdx++ )
         {
-            // check if they are mutual best matches
-            int lr_qdx = pmatches_12[i][0].queryIdx;
-            int lr_tdx = pmatches_12[i][0].trainIdx;
+            // check if they are mutual best matches, skip the points without candidates
+            int lr_tdx = pmatches_12[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             int rl_tdx;
             if( Config::bestLRMatches() )
-                rl_tdx = pmatches_21[lr_tdx][0].trainIdx;
+                rl_tdx = pmatches_21[lr_tdx].trainIdx[0];
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_nn = pmatches_12[i][0].distance;
-            double dist_12 = pmatches_12[i][0].distance / pmatches_12[i][1].distance;
+            double dist_nn = pmatches_12[lr_qdx].distance[0];
+            double dist_12 = double(pmatches_12[lr_qdx].distance[0]) / double(pmatches_12[lr_qdx].distance[1]);
             // check the f2f max disparity condition
-            double dispL   = fabsf( curr_frame->stereo_pt[lr_tdx]->pl(0) - prev_frame->stereo_pt[lr_qdx]->pl(0) );
-            double dispR   = fabsf( curr_frame->stereo_pt[lr_tdx]->pl(0) - curr_frame->stereo_pt[lr_tdx]->disp
-                                    - ( prev_frame->stereo_pt[lr_qdx]->pl(0) - prev_frame->stereo_pt[lr_qdx]->disp ) );
+            double dispL   = fabsf( curr_frame->stereo_pt.pl[lr_tdx](0) - prev_frame->stereo_pt.pl[lr_qdx](0) );
+            double dispR   = fabsf( curr_frame->stereo_pt.pl[lr_tdx](0) - curr_frame->stereo_pt.disp[lr_tdx]
+                                    - ( prev_frame->stereo_pt.pl[lr_qdx](0) - prev_frame->stereo_pt.disp[lr_qdx] ) );
             if( lr_qdx == rl_tdx  && dist_12 > nn12_dist_th && dispL <= dispTh && dispR <= dispTh )
             {
-                PointFeature* point_ = prev_frame->stereo_pt[lr_qdx];
-                point_->pl_obs = curr_frame->stereo_pt[lr_tdx]->pl;
-                point_->inlier = true;
-                matched_pt.push_back( point_ );                
-                curr_frame->stereo_pt[lr_tdx]->idx = prev_frame->stereo_pt[lr_qdx]->idx; // prev idx
+                matched_pt.push_back( prev_frame->stereo_pt, lr_qdx, curr_frame->stereo_pt, lr_tdx );
+                curr_frame->stereo_pt.idx[lr_tdx] = prev_frame->stereo_pt.idx[lr_qdx]; // prev idx
             }
             else
             {
-                curr_frame->stereo_pt[lr_tdx]->idx = max_idx_pt;
+                curr_frame->stereo_pt.idx[lr_tdx] = max_idx_pt;
                 max_idx_pt++;
             }
         }
@@ -120,9 +191,9 @@ void StereoFrameHandler::f2fTracking()
         // put index on the rest of the features
         for( int i = 0; i < curr_frame->stereo_pt.size(); i++)
         {
-            if( curr_frame->stereo_pt[i]->idx == -1 )
+            if( curr_frame->stereo_pt.idx[i] == -1 )
             {
-                curr_frame->stereo_pt[i]->idx = max_idx_pt;
+                curr_frame->stereo_pt.idx[i] = max_idx_pt;
                 max_idx_pt++;
             }
         }
@@ -133,71 +204,66 @@ void StereoFrameHandler::f2fTracking()
     matched_ls.clear();
     if( Config::hasLines() && !(curr_frame->stereo_ls.size()==0) && !(prev_frame->stereo_ls.size()==0)  )
     {
-        Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
         Mat ldesc_l1, ldesc_l2;
-        vector<vector<DMatch>> lmatches_12, lmatches_21;
+        KnnMatches lmatches_12, lmatches_21;
         // 12 and 21 matches
         ldesc_l1 = prev_frame->ldesc_l;
         ldesc_l2 = curr_frame->ldesc_l;
-        if( Config::bestLRMatches() )
+        if( Config::f2fGridSearch() && Config::simdMatching() && HammingMatcher::supports( ldesc_l1, ldesc_l2 ) )
+            matchLinesInWindow( ldesc_l1, ldesc_l2, lmatches_12, lmatches_21 );
+        else if( Config::bestLRMatches() && Config::simdMatching() && HammingMatcher::supports( ldesc_l1, ldesc_l2 ) )
+            MatcherCostModel::adaptiveCrossCheckMatch( ldesc_l1, ldesc_l2, lmatches_12, lmatches_21 );
+        else if( Config::bestLRMatches() )
         {
             if( Config::lrInParallel() )
             {
-                auto match_l = async( launch::async, &StereoFrameHandler::matchLineFeatures, this, bdm, ldesc_l1, ldesc_l2, ref(lmatches_12) );
-                auto match_r = async( launch::async, &StereoFrameHandler::matchLineFeatures, this, bdm, ldesc_l2, ldesc_l1, ref(lmatches_21) );
-                match_l.wait();
-                match_r.wait();
+                auto match_l = ThreadPool::getInstance().submit( &StereoFrameHandler::matchLineFeatures, this, ldesc_l1, curr_frame, ref(lmatches_12) );
+                auto match_r = ThreadPool::getInstance().submit( &StereoFrameHandler::matchLineFeatures, this, ldesc_l2, prev_frame, ref(lmatches_21) );
+                ThreadPool::getInstance().wait( match_l );
+                ThreadPool::getInstance().wait( match_r );
             }
             else
             {
-                bdm->knnMatch( ldesc_l1, ldesc_l2, lmatches_12, 2);
-                bdm->knnMatch( ldesc_l2, ldesc_l1, lmatches_21, 2);
+                matchLineFeatures( ldesc_l1, curr_frame, lmatches_12 );
+                matchLineFeatures( ldesc_l2, prev_frame, lmatches_21 );
             }
         }
         else
-            bdm->knnMatch( ldesc_l1, ldesc_l2, lmatches_12, 2);
+            matchLineFeatures( ldesc_l1, curr_frame, lmatches_12 );
 
         // sort matches by the distance between the best and second best matches
         double nn_dist_th, nn12_dist_th;
         curr_frame->lineDescriptorMAD(lmatches_12,nn_dist_th, nn12_dist_th);
         nn12_dist_th  = nn12_dist_th * Config::descThL();
 
-        // resort according to the queryIdx
-        sort( lmatches_12.begin(), lmatches_12.end(), sort_descriptor_by_queryIdx() );
-        if( Config::bestLRMatches() )
-            sort( lmatches_21.begin(), lmatches_21.end(), sort_descriptor_by_queryIdx() );
-        // bucle around pmatches
-        for( int i = 0; i < lmatches_12.size(); i++ )
+        // bucle around lmatches (indexed by queryIdx)
+        for( int lr_qdx = 0; lr_qdx < lmatches_12.size(); lr_qdx++ )
         {
-            // check if they are mutual best matches
-            int lr_qdx = lmatches_12[i][0].queryIdx;
-            int lr_tdx = lmatches_12[i][0].trainIdx;
+            // check if they are mutual best matches, skip the lines without candidates
+            int lr_tdx = lmatches_12[lr_qdx].trainIdx[0];
+            if( lr_tdx < 0 )
+                continue;
             int rl_tdx;
             if( Config::bestLRMatches() )
-                rl_tdx = lmatches_21[lr_tdx][0].trainIdx;
+                rl_tdx = lmatches_21[lr_tdx].trainIdx[0];
             else
                 rl_tdx = lr_qdx;
             // check if they are mutual best matches and the minimum distance
-            double dist_12 = lmatches_12[i][1].distance - lmatches_12[i][0].distance;
+            double dist_12 = lmatches_12[lr_qdx].distance[1] - lmatches_12[lr_qdx].distance[0];
 
             // f2f angle diff and flow
-            double a1 = prev_frame->stereo_ls[lr_qdx]->angle;
-            double a2 = curr_frame->stereo_ls[lr_tdx]->angle;
-            Vector2d x1 = (prev_frame->stereo_ls[lr_qdx]->spl + prev_frame->stereo_ls[lr_qdx]->epl);
-            Vector2d x2 = (curr_frame->stereo_ls[lr_tdx]->spl + curr_frame->stereo_ls[lr_tdx]->epl);
+            double a1 = prev_frame->stereo_ls.angle[lr_qdx];
+            double a2 = curr_frame->stereo_ls.angle[lr_tdx];
+            Vector2d x1 = (prev_frame->stereo_ls.spl[lr_qdx] + prev_frame->stereo_ls.epl[lr_qdx]);
+            Vector2d x2 = (curr_frame->stereo_ls.spl[lr_tdx] + curr_frame->stereo_ls.epl[lr_tdx]);
             if( lr_qdx == rl_tdx  && dist_12 > nn12_dist_th && angDiff(a1,a2) < Config::maxF2FAngDiff() && (x2-x1).norm() < 2.0 * Config::f2fFlowTh() )
             {
-                LineFeature* line_ = prev_frame->stereo_ls[lr_qdx];
-                line_->spl_obs = curr_frame->stereo_ls[lr_tdx]->spl;
-                line_->epl_obs = curr_frame->stereo_ls[lr_tdx]->epl;
-                line_->le_obs  = curr_frame->stereo_ls[lr_tdx]->le;               
-                line_->inlier  = true;
-                matched_ls.push_back( line_ );
-                curr_frame->stereo_ls[lr_tdx]->idx = prev_frame->stereo_ls[lr_qdx]->idx; // prev idx
+                matched_ls.push_back( prev_frame->stereo_ls, lr_qdx, curr_frame->stereo_ls, lr_tdx );
+                curr_frame->stereo_ls.idx[lr_tdx] = prev_frame->stereo_ls.idx[lr_qdx]; // prev idx
             }
             else
             {
-                curr_frame->stereo_ls[lr_tdx]->idx = max_idx_ls;
+                curr_frame->stereo_ls.idx[lr_tdx] = max_idx_ls;
                 max_idx_ls++;
             }
         }
@@ -205,9 +271,9 @@ void StereoFrameHandler::f2fTracking()
         // put index on the rest of the features
         for( int i = 0; i < curr_frame->stereo_ls.size(); i++)
         {
-            if( curr_frame->stereo_ls[i]->idx == -1 )
+            if( curr_frame->stereo_ls.idx[i] == -1 )
             {
-                curr_frame->stereo_ls[i]->idx = max_idx_ls;
+                curr_frame->stereo_ls.idx[i] = max_idx_ls;
                 max_idx_ls++;
             }
         }
@@ -220,14 +286,163 @@ void StereoFrameHandler::f2fTracking()
 
 }
 
-void StereoFrameHandler::matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, vector<vector<DMatch>> &pmatches_12  )
+void StereoFrameHandler::matchPointFeatures(BFMatcher* bfm, Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12  )
+{
+    if( Config::simdMatching() && HammingMatcher::supports( pdesc_1, pdesc_2 ) )
+        HammingMatcher::knnMatch( pdesc_1, pdesc_2, pmatches_12 );
+    else
+    {
+        vector<vector<DMatch>> pmatches_;
+        bfm->knnMatch( pdesc_1, pdesc_2, pmatches_, 2);
+        toKnnMatches( pmatches_, pdesc_1.rows, 8 * pdesc_2.cols, pmatches_12 );
+    }
+}
+
+void StereoFrameHandler::matchLineFeatures(Mat ldesc_1, StereoFrame* frame_2, KnnMatches &lmatches_12  )
 {
-    bfm->knnMatch( pdesc_1, pdesc_2, pmatches_12, 2);
+    // the index of each frame is built once and queried from this frame and the next one
+    if( Config::simdMatching() && HammingMatcher::supports( ldesc_1, frame_2->ldesc_l ) )
+        HammingMatcher::knnMatch( ldesc_1, frame_2->ldesc_l, lmatches_12 );
+    else
+    {
+        vector<vector<DMatch>> lmatches_;
+        frame_2->lineIndex()->knnMatch( ldesc_1, lmatches_, 2);
+        toKnnMatches( lmatches_, ldesc_1.rows, 8 * frame_2->ldesc_l.cols, lmatches_12 );
+    }
 }
 
-void StereoFrameHandler::matchLineFeatures(Ptr<BinaryDescriptorMatcher> bdm, Mat ldesc_1, Mat ldesc_2, vector<vector<DMatch>> &lmatches_12  )
+void StereoFrameHandler::matchPointsInWindow( Mat pdesc_1, Mat pdesc_2, KnnMatches &pmatches_12, KnnMatches &pmatches_21 )
 {
-    bdm->knnMatch( ldesc_1, ldesc_2, lmatches_12, 2);
+
+    // grid over the current points (without guidance only x is gated, so the cells span the image height)
+    double dispTh = Config::maxF2FDisp() * cam->getWidth();
+    bool   guided = Config::guidedMatching() && hasMotionPrediction();
+    SE3 DT_pred = prev_frame->DT.inverse();
+    vector<double> xs, ys;
+    for( int j = 0; j < curr_frame->stereo_pt.size(); j++ )
+    {
+        xs.push_back( curr_frame->stereo_pt.pl[j](0) );
+        ys.push_back( curr_frame->stereo_pt.pl[j](1) );
+    }
+    GridIndex grid;
+    if( guided )
+        grid.build( xs, ys, 2.0 * Config::guidedMinWin(), 2.0 * Config::guidedMinWin() );
+    else
+        grid.build( xs, ys, dispTh, cam->getHeight() );
+
+    // candidates within the window (around the predicted projection if guided) satisfying the same
+    // f2f disparity conditions as the tracking
+    vector<int> offsets( 1, 0 ), cand;
+    for( int i = 0; i < prev_frame->stereo_pt.size(); i++ )
+    {
+        const Vector2d &pl = prev_frame->stereo_pt.pl[i];
+        double disp = prev_frame->stereo_pt.disp[i];
+        int first = cand.size();
+        Vector2d pl_pred, win;
+        if( !guided )
+            grid.query( pl(0) - dispTh, -DBL_MAX, pl(0) + dispTh, DBL_MAX, cand );
+        else if( predictProjection( DT_pred, prev_frame->stereo_pt.P[i], pl_pred, win ) )
+            grid.query( pl_pred(0) - win(0), pl_pred(1) - win(1), pl_pred(0) + win(0), pl_pred(1) + win(1), cand );
+        int last = first;
+        for( int k = first; k < cand.size(); k++ )
+        {
+            const Vector2d &pl_ = curr_frame->stereo_pt.pl[cand[k]];
+            double disp_ = curr_frame->stereo_pt.disp[cand[k]];
+            if( fabsf( pl_(0) - pl(0) ) <= dispTh && fabsf( pl_(0) - disp_ - ( pl(0) - disp ) ) <= dispTh )
+                cand[last++] = cand[k];
+        }
+        cand.resize( last );
+        sort( cand.begin() + first, cand.end() );
+        offsets.push_back( cand.size() );
+    }
+
+    MatcherCostModel::adaptiveCrossCheckMatch( pdesc_1, pdesc_2, offsets, cand, pmatches_12, pmatches_21 );
+
+}
+
+void StereoFrameHandler::matchLinesInWindow( Mat ldesc_1, Mat ldesc_2, KnnMatches &lmatches_12, KnnMatches &lmatches_21 )
+{
+
+    // grid over the midpoints of the current line segments
+    double flowTh = Config::f2fFlowTh();
+    bool   guided = Config::guidedMatching() && hasMotionPrediction();
+    SE3 DT_pred = prev_frame->DT.inverse();
+    vector<double> xs, ys;
+    for( int j = 0; j < curr_frame->stereo_ls.size(); j++ )
+    {
+        Vector2d x_ = 0.5 * ( curr_frame->stereo_ls.spl[j] + curr_frame->stereo_ls.epl[j] );
+        xs.push_back( x_(0) );
+        ys.push_back( x_(1) );
+    }
+    GridIndex grid;
+    if( guided )
+        grid.build( xs, ys, 2.0 * Config::guidedMinWin(), 2.0 * Config::guidedMinWin() );
+    else
+        grid.build( xs, ys, flowTh, flowTh );
+
+    // candidates within the window (around the predicted midpoint if guided) satisfying the same
+    // f2f angle and flow conditions as the tracking
+    vector<int> offsets( 1, 0 ), cand;
+    for( int i = 0; i < prev_frame->stereo_ls.size(); i++ )
+    {
+        Vector2d x1 = prev_frame->stereo_ls.spl[i] + prev_frame->stereo_ls.epl[i];
+        int first = cand.size();
+        Vector2d spl_pred, epl_pred, swin, ewin;
+        if( !guided )
+            grid.query( 0.5*x1(0) - flowTh, 0.5*x1(1) - flowTh, 0.5*x1(0) + flowTh, 0.5*x1(1) + flowTh, cand );
+        else if( predictProjection( DT_pred, prev_frame->stereo_ls.sP[i], spl_pred, swin ) && predictProjection( DT_pred, prev_frame->stereo_ls.eP[i], epl_pred, ewin ) )
+        {
+            Vector2d x_ = 0.5 * ( spl_pred + epl_pred );
+            Vector2d win_ = swin.cwiseMax( ewin );
+            grid.query( x_(0) - win_(0), x_(1) - win_(1), x_(0) + win_(0), x_(1) + win_(1), cand );
+        }
+        int last = first;
+        for( int k = first; k < cand.size(); k++ )
+        {
+            Vector2d x2 = curr_frame->stereo_ls.spl[cand[k]] + curr_frame->stereo_ls.epl[cand[k]];
+            if( angDiff(prev_frame->stereo_ls.angle[i],curr_frame->stereo_ls.angle[cand[k]]) < Config::maxF2FAngDiff() && (x2-x1).norm() < 2.0 * flowTh )
+                cand[last++] = cand[k];
+        }
+        cand.resize( last );
+        sort( cand.begin() + first, cand.end() );
+        offsets.push_back( cand.size() );
+    }
+
+    MatcherCostModel::adaptiveCrossCheckMatch( ldesc_1, ldesc_2, offsets, cand, lmatches_12, lmatches_21 );
+
+}
+
+bool StereoFrameHandler::hasMotionPrediction()
+{
+    // the previous motion was successfully estimated (see optimizePose)
+    return prev_frame->err_norm >= 0.0 && prev_frame->DT_cov.trace() > 0.0 && is_finite( prev_frame->DT_cov );
+}
+
+bool StereoFrameHandler::predictProjection( const SE3 &DT_pred, const Vector3d &P, Vector2d &pl_pred, Vector2d &win )
+{
+
+    // constant velocity prediction
+    Vector3d P_ = DT_pred * P;
+    if( P_(2) <= Config::homogTh() )
+        return false;
+    pl_pred = cam->projection( P_ );
+
+    // propagate the motion covariance through the projection jacobian (as in the optimization)
+    double gx   = P_(0);
+    double gy   = P_(1);
+    double gz   = P_(2);
+    double fgz2 = cam->getFx() / ( gz*gz );
+    Matrix<double,2,6> J;
+    J << fgz2 * gz, 0.0,       - fgz2 * gx, - fgz2 * gx*gy,           + fgz2 * ( gx*gx + gz*gz ), - fgz2 * gy*gz,
+         0.0,       fgz2 * gz, - fgz2 * gy, - fgz2 * ( gy*gy + gz*gz ), + fgz2 * gx*gy,             + fgz2 * gx*gz;
+    Matrix2d S = J * prev_frame->DT_cov * J.transpose();
+
+    // window half size, never larger than the f2f disparity gate
+    double max_win = Config::maxF2FDisp() * cam->getWidth();
+    for( int k = 0; k < 2; k++ )
+        win(k) = std::min( Config::guidedWinK() * sqrt( std::max( S(k,k), 0.0 ) ) + Config::guidedMinWin(), max_win );
+    return true;
+
 }
 
 void StereoFrameHandler::updateFrame()
@@ -243,9 +458,12 @@ void StereoFrameHandler::optimizePose()
 
     // definitions
     Matrix6d DT_cov;
-    Matrix4d DT, DT_;
+    SE3 DT, DT_;
     double   err;
 
+    // cost function for the current configuration
+    selectCostFunction();
+
     // set init pose    (depending on the values of DT_cov_eig)
     if( true )
     {
@@ -263,7 +481,7 @@ void StereoFrameHandler::optimizePose()
         else
             gaussNewtonOptimization(DT_,DT_cov,err,Config::maxIters());
         // remove outliers (implement some logic based on the covariance's eigenvalues and optim error)
-        if( is_finite(DT_) )
+        if( DT_.isFinite() )
         {
             removeOutliers(DT_);
             // refine without outliers
@@ -276,26 +494,26 @@ void StereoFrameHandler::optimizePose()
             }
             else
             {
-                DT     = Matrix4d::Identity();
+                DT     = SE3();
                 DT_cov = Matrix6d::Zero();
             }
         }
         else
         {
-            DT     = Matrix4d::Identity();
+            DT     = SE3();
             DT_cov = Matrix6d::Zero();
         }
     }
     else
     {
-        DT     = Matrix4d::Identity();
+        DT     = SE3();
         DT_cov = Matrix6d::Zero();
     }
 
     // set estimated pose
-    if( is_finite(DT_) && err < Config::maxOptimError() )
+    if( DT_.isFinite() && err < Config::maxOptimError() )
     {
-        curr_frame->DT     = inverse_transformation( DT );  //check what's best
+        curr_frame->DT     = DT.inverse();  //check what's best
         curr_frame->Tfw    = prev_frame->Tfw * curr_frame->DT;
         curr_frame->DT_cov = DT_cov;
         SelfAdjointEigenSolver<Matrix6d> eigensolver(DT_cov);
@@ -304,7 +522,7 @@ void StereoFrameHandler::optimizePose()
     }
     else
     {
-        curr_frame->DT     = Matrix4d::Identity();
+        curr_frame->DT     = SE3();
         curr_frame->Tfw    = prev_frame->Tfw;
         curr_frame->DT_cov = Matrix6d::Zero();
         SelfAdjointEigenSolver<Matrix6d> eigensolver(DT_cov);
@@ -314,14 +532,17 @@ void StereoFrameHandler::optimizePose()
 
 }
 
-void StereoFrameHandler::optimizePose(Matrix4d DT_ini)
+void StereoFrameHandler::optimizePose(const SE3 &DT_ini)
 {
 
     // definitions
     Matrix6d DT_cov;
-    Matrix4d DT, DT_;
+    SE3 DT, DT_;
     double   err;
 
+    // cost function for the current configuration
+    selectCostFunction();
+
     // set init pose    (depending on the values of DT_cov_eig)
     DT     = DT_ini;
     DT_cov = prev_frame->DT_cov;
@@ -336,7 +557,7 @@ void StereoFrameHandler::optimizePose(Matrix4d DT_ini)
         else
             gaussNewtonOptimization(DT_,DT_cov,err,Config::maxIters());
         // remove outliers (implement some logic based on the covariance's eigenvalues and optim error)
-        if( is_finite(DT_) )
+        if( DT_.isFinite() )
         {
             removeOutliers(DT_);
             // refine without outliers
@@ -349,26 +570,26 @@ void StereoFrameHandler::optimizePose(Matrix4d DT_ini)
             }
             else
             {
-                DT     = Matrix4d::Identity();
+                DT     = SE3();
                 DT_cov = Matrix6d::Zero();
             }
         }
         else
         {
-            DT     = Matrix4d::Identity();
+            DT     = SE3();
             DT_cov = Matrix6d::Zero();
         }
     }
     else
     {
-        DT     = Matrix4d::Identity();
+        DT     = SE3();
         DT_cov = Matrix6d::Zero();
     }
 
     // set estimated pose
-    if( is_finite(DT_) && err < Config::maxOptimError() )
+    if( DT_.isFinite() && err < Config::maxOptimError() )
     {
-        curr_frame->DT     = inverse_transformation( DT );  //check what's best
+        curr_frame->DT     = DT.inverse();  //check what's best
         curr_frame->Tfw    = prev_frame->Tfw * curr_frame->DT;
         curr_frame->DT_cov = DT_cov;
         SelfAdjointEigenSolver<Matrix6d> eigensolver(DT_cov);
@@ -377,7 +598,7 @@ void StereoFrameHandler::optimizePose(Matrix4d DT_ini)
     }
     else
     {
-        curr_frame->DT     = Matrix4d::Identity();
+        curr_frame->DT     = SE3();
         curr_frame->Tfw    = prev_frame->Tfw;
         curr_frame->DT_cov = Matrix6d::Zero();
         SelfAdjointEigenSolver<Matrix6d> eigensolver(DT_cov);
@@ -387,18 +608,15 @@ void StereoFrameHandler::optimizePose(Matrix4d DT_ini)
 
 }
 
-void StereoFrameHandler::gaussNewtonOptimization(Matrix4d &DT, Matrix6d &DT_cov, double &err_, int max_iters)
+void StereoFrameHandler::gaussNewtonOptimization(SE3 &DT, Matrix6d &DT_cov, double &err_, int max_iters)
 {
     Matrix6d H;
     Vector6d g, DT_inc;
     double err, err_prev = 999999999.9;
     for( int iters = 0; iters < max_iters; iters++)
     {
-        // estimate hessian and gradient (select)
-        if( Config::useUncertainty() )
-            optimizeFunctions_uncweighted( DT, H, g, err );
-        else
-            optimizeFunctions_nonweighted( DT, H, g, err );
+        // estimate hessian and gradient (cost function selected in optimizePose)
+        (this->*cost_function)( DT, H, g, err );
         // if the difference is very small stop
         if( ( abs(err-err_prev) < Config::minErrorChange() ) || ( err < Config::minError()) )
             break;
@@ -410,13 +628,13 @@ void StereoFrameHandler::gaussNewtonOptimization(Matrix4d &DT, Matrix6d &DT_cov,
             g += prior_cov_inv * ( DT_inc - prior_inc );
             LDLT<Matrix6d> solver(H);
             DT_inc = solver.solve(g);
-            DT  << DT * inverse_transformation( transformation_expmap(DT_inc) );
+            DT  = DT * SE3::exp(DT_inc).inverse();
         }
         else
         {
             LDLT<Matrix6d> solver(H);
             DT_inc = solver.solve(g);
-            DT  << DT * inverse_transformation( transformation_expmap(DT_inc) );
+            DT  = DT * SE3::exp(DT_inc).inverse();
         }
         // if the parameter change is small stop (TODO: change with two parameters, one for R and another one for t)
         if( DT_inc.norm() < numeric_limits<double>::epsilon() )
@@ -428,20 +646,17 @@ void StereoFrameHandler::gaussNewtonOptimization(Matrix4d &DT, Matrix6d &DT_cov,
     err_   = err;
 }
 
-void StereoFrameHandler::levMarquardtOptimization(Matrix4d &DT, Matrix6d &DT_cov, double &err_, int max_iters)
+void StereoFrameHandler::levMarquardtOptimization(SE3 &DT, Matrix6d &DT_cov, double &err_, int max_iters)
 {
     Matrix6d H;
     Vector6d g, DT_inc;
-    Matrix4d DT_;
+    SE3 DT_;
     double err, err_prev = 999999999.9;
     double lambda = Config::lambdaLM(), lambda_k = Config::lambdaK();
     for( int iters = 0; iters < max_iters; iters++)
     {
-        // estimate hessian and gradient (select)
-        if( Config::useUncertainty() )
-            optimizeFunctions_uncweighted( DT, H, g, err );
-        else
-            optimizeFunctions_nonweighted( DT, H, g, err );
+        // estimate hessian and gradient (cost function selected in optimizePose)
+        (this->*cost_function)( DT, H, g, err );
         // if the difference is very small stop
         if( ( abs(err-err_prev) < Config::minErrorChange() ) || ( err < Config::minError()) )
             break;
@@ -449,7 +664,7 @@ void StereoFrameHandler::levMarquardtOptimization(Matrix4d &DT, Matrix6d &DT_cov
         H += lambda * H.diagonal().asDiagonal();
         LDLT<Matrix6d> solver(H);
         DT_inc = solver.solve(g);
-        DT_  << DT * inverse_transformation( transformation_expmap(DT_inc) );
+        DT_  = DT * SE3::exp(DT_inc).inverse();
         // update lambda
         if( err > err_prev )
             lambda /= lambda_k;
@@ -468,30 +683,29 @@ void StereoFrameHandler::levMarquardtOptimization(Matrix4d &DT, Matrix6d &DT_cov
     err_   = err;
 }
 
-void StereoFrameHandler::removeOutliers(Matrix4d DT)
+void StereoFrameHandler::removeOutliers(const SE3 &DT)
 {
 
     vector<double> res_p, res_l;
 
     // point features
-    int iter = 0;
-    for( list<PointFeature*>::iterator it = matched_pt.begin(); it!=matched_pt.end(); it++, iter++)
+    for( int i = 0; i < matched_pt.size(); i++ )
     {
         // projection error
-        Vector3d P_ = DT.block(0,0,3,3) * (*it)->P + DT.col(3).head(3);
+        Vector3d P_ = DT * matched_pt.P[i];
         Vector2d pl_proj = cam->projection( P_ );
-        res_p.push_back( ( pl_proj - (*it)->pl_obs ).norm() );
+        res_p.push_back( ( pl_proj - matched_pt.pl_obs[i] ).norm() );
     }
 
     // line segment features
-    for( list<LineFeature*>::iterator it = matched_ls.begin(); it!=matched_ls.end(); it++, iter++)
+    for( int i = 0; i < matched_ls.size(); i++ )
     {
         // projection error
-        Vector3d sP_ = DT.block(0,0,3,3) * (*it)->sP + DT.col(3).head(3);
-        Vector3d eP_ = DT.block(0,0,3,3) * (*it)->eP + DT.col(3).head(3);
+        Vector3d sP_ = DT * matched_ls.sP[i];
+        Vector3d eP_ = DT * matched_ls.eP[i];
         Vector2d spl_proj = cam->projection( sP_ );
         Vector2d epl_proj = cam->projection( eP_ );
-        Vector3d l_obs    = (*it)->le_obs;
+        Vector3d l_obs    = matched_ls.le_obs[i];
         Vector2d err_li;
         err_li(0) = l_obs(0) * spl_proj(0) + l_obs(1) * spl_proj(1) + l_obs(2);
         err_li(1) = l_obs(0) * epl_proj(0) + l_obs(1) * epl_proj(1) + l_obs(2);
@@ -503,22 +717,20 @@ void StereoFrameHandler::removeOutliers(Matrix4d DT)
     double inlier_th_l =  Config::inlierK() * vector_stdv_mad( res_l );
 
     // filter outliers
-    iter = 0;
-    for( list<PointFeature*>::iterator it = matched_pt.begin(); it!=matched_pt.end(); it++, iter++)
+    for( int i = 0; i < matched_pt.size(); i++ )
     {
-        if( res_p[iter] > inlier_th_p )
+        if( res_p[i] > inlier_th_p )
         {
-            (*it)->inlier = false;
+            matched_pt.inlier[i] = false;
             n_inliers--;
             n_inliers_pt--;
         }
     }
-    iter = 0;
-    for( list<LineFeature*>::iterator it = matched_ls.begin(); it!=matched_ls.end(); it++, iter++)
+    for( int i = 0; i < matched_ls.size(); i++ )
     {
-        if( res_l[iter] > inlier_th_l )
+        if( res_l[i] > inlier_th_l )
         {
-            (*it)->inlier = false;
+            matched_ls.inlier[i] = false;
             n_inliers--;
             n_inliers_ls--;
         }
@@ -526,7 +738,19 @@ void StereoFrameHandler::removeOutliers(Matrix4d DT)
 
 }
 
-void StereoFrameHandler::optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H, Vector6d &g, double &e )
+// evaluates body(i) for the n matches, split among the thread pool workers if parallel
+template<class Body>
+static void forEachMatch( int n, bool parallel, const Body &body )
+{
+    if( parallel )
+        ThreadPool::getInstance().parallelFor( n, 64, body );
+    else
+        for( int i = 0; i < n; i++ )
+            body( i );
+}
+
+template<class Kernel, bool Points, bool Lines, bool Scale>
+void StereoFrameHandler::optimizeFunctions_nonweighted(const SE3 &DT, Matrix6d &H, Vector6d &g, double &e )
 {
 
     // define hessians, gradients, and residuals
@@ -536,21 +760,24 @@ void StereoFrameHandler::optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H,
     H   = Matrix6d::Zero(); H_l = H; H_p = H;
     g   = Vector6d::Zero(); g_l = g; g_p = g;
     e   = 0.0;
+    const double homog_th = Config::homogTh();
 
     // point features
-    int N_p = 0;
+    int N_p = 0, n_p = Points ? matched_pt.size() : 0;
+    bool parallel_p = n_p >= Config::parallelCostTh();
     vector<double> r_p;
-    for( list<PointFeature*>::iterator it = matched_pt.begin(); it!=matched_pt.end(); it++)
+    neq_p.resize( n_p );
+    forEachMatch( n_p, parallel_p, [&]( int i )
     {
-        if( (*it)->inlier )
+        if( matched_pt.inlier[i] )
         {
-            Vector3d P_ = DT.block(0,0,3,3) * (*it)->P + DT.col(3).head(3);
+            Vector3d P_ = DT * matched_pt.P[i];
             Vector2d pl_proj = cam->projection( P_ );
             // projection error
-            Vector2d err_i    = pl_proj - (*it)->pl_obs;
+            Vector2d err_i    = pl_proj - matched_pt.pl_obs[i];
             double err_i_norm = err_i.norm();
             // check inverse of err_i_norm
-            if( err_i_norm > Config::homogTh() )
+            if( err_i_norm > homog_th )
             {
                 double gx   = P_(0);
                 double gy   = P_(1);
@@ -568,44 +795,43 @@ void StereoFrameHandler::optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H,
                          + fgz2 * ( gx*gx*dx + gz*gz*dx + gx*gy*dy ),
                          + fgz2 * ( gx*gz*dy - gy*gz*dx );
                 J_aux = J_aux / std::max(0.0000001,err_i_norm);
-                // if employing robust cost function
-                double w = 1.0;
-                if( Config::robustCost() )
-                    w = 1.0 / ( 1.0 + err_i_norm * err_i_norm );
+                // robust cost function
+                double w = Kernel::weight( err_i_norm * err_i_norm );
                 // update hessian, gradient, and error
-                H_p += J_aux * J_aux.transpose() * w;
-                g_p += J_aux * err_i_norm * w;
-                e_p += err_i_norm * err_i_norm * w;
-                N_p++;
-                if( Config::scalePointsLines() )
-                    r_p.push_back( err_i_norm * err_i_norm * w );
+                neq_p.set( i, J_aux, w, err_i_norm * w, err_i_norm * err_i_norm * w );
             }
             else
-                (*it)->inlier = false;
+                matched_pt.inlier[i] = false;
         }
+    } );
+    neq_p.sum( H_p, g_p, e_p, N_p, parallel_p );
+    if( Scale )
+    {
+        neq_p.errors( r_p );
+        S_p = stdvMADSelect(r_p);
     }
-    if( Config::scalePointsLines() )
-        S_p = vector_stdv_mad(r_p);
 
     // line segment features
-    int N_l = 0;
+    int N_l = 0, n_l = Lines ? matched_ls.size() : 0;
+    bool parallel_l = n_l >= Config::parallelCostTh();
     vector<double> r_l;
-    for( list<LineFeature*>::iterator it = matched_ls.begin(); it!=matched_ls.end(); it++)
+    neq_l.resize( n_l );
+    forEachMatch( n_l, parallel_l, [&]( int i )
     {
-        if( (*it)->inlier )
+        if( matched_ls.inlier[i] )
         {
-            Vector3d sP_ = DT.block(0,0,3,3) * (*it)->sP + DT.col(3).head(3);
+            Vector3d sP_ = DT * matched_ls.sP[i];
             Vector2d spl_proj = cam->projection( sP_ );
-            Vector3d eP_ = DT.block(0,0,3,3) * (*it)->eP + DT.col(3).head(3);
+            Vector3d eP_ = DT * matched_ls.eP[i];
             Vector2d epl_proj = cam->projection( eP_ );
-            Vector3d l_obs = (*it)->le_obs;
+            Vector3d l_obs = matched_ls.le_obs[i];
             // projection error
             Vector2d err_i;
             err_i(0) = l_obs(0) * spl_proj(0) + l_obs(1) * spl_proj(1) + l_obs(2);
             err_i(1) = l_obs(0) * epl_proj(0) + l_obs(1) * epl_proj(1) + l_obs(2);
             double err_i_norm = err_i.norm();
             // check inverse of err_i_norm
-            if( err_i_norm > Config::homogTh() )
+            if( err_i_norm > homog_th )
             {
                 // start point
                 double gx   = sP_(0);
@@ -639,29 +865,25 @@ void StereoFrameHandler::optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H,
                           + fgz2 * ( gx*gz*ly - gy*gz*lx );
                 // jacobian
                 J_aux = ( Js_aux * ds + Je_aux * de ) / std::max(0.0000001,err_i_norm);
-                // if employing robust cost function
-                double w = 1.0;
-                if( Config::robustCost() )
-                    w = 1.0 / ( 1.0 + err_i_norm * err_i_norm );
+                // robust cost function
+                double w = Kernel::weight( err_i_norm * err_i_norm );
                 // update hessian, gradient, and error
-                H_l += J_aux * J_aux.transpose() * w;
-                g_l += J_aux * err_i_norm * w;
-                e_l += err_i_norm * err_i_norm * w;
-                N_l++;
-                if( Config::scalePointsLines() )
-                    r_l.push_back( err_i_norm * err_i_norm * w );
+                neq_l.set( i, J_aux, w, err_i_norm * w, err_i_norm * err_i_norm * w );
             }
             else
-                (*it)->inlier = false;
+                matched_ls.inlier[i] = false;
         }
 
+    } );
+    neq_l.sum( H_l, g_l, e_l, N_l, parallel_l );
+    if( Scale )
+    {
+        neq_l.errors( r_l );
+        S_l = stdvMADSelect(r_l);
     }
-    if( Config::scalePointsLines() )
-        S_l = vector_stdv_mad(r_l);
 
     // sum H, g and err from both points and lines
-    if( Config::scalePointsLines() && S_l > Config::homogTh() && S_p > Config::homogTh() &&
-        Config::hasPoints() && Config::hasLines() )
+    if( Scale && S_l > homog_th && S_p > homog_th )
     {
         double S_l_inv = 1.0 / S_l;
         double S_p_inv = 1.0 / S_p;
@@ -683,7 +905,43 @@ void StereoFrameHandler::optimizeFunctions_nonweighted(Matrix4d DT, Matrix6d &H,
 
 }
 
-void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H, Vector6d &g, double &e )
+void StereoFrameHandler::selectCostFunction()
+{
+
+    // the MAD scaling only applies when both points and lines are used
+    bool points = Config::hasPoints();
+    bool lines  = Config::hasLines();
+    bool scale  = Config::scalePointsLines() && points && lines;
+    if( Config::useUncertainty() )
+    {
+        // back-projection covariances of the matched features, which do not change along the
+        // optimization (computed here so that they always match the selected cost function)
+        matched_pt.computeCovariances( cam->getFx(), cam->getCx(), cam->getCy() );
+        matched_ls.computeCovariances( cam->getFx(), cam->getCx(), cam->getCy() );
+        cost_function = &StereoFrameHandler::optimizeFunctions_uncweighted;
+    }
+    else if( Config::robustCost() )
+        cost_function = nonweightedCostFunction<CauchyLoss>( points, lines, scale );
+    else
+        cost_function = nonweightedCostFunction<SquaredLoss>( points, lines, scale );
+
+}
+
+template<class Kernel>
+StereoFrameHandler::CostFunction StereoFrameHandler::nonweightedCostFunction( bool points, bool lines, bool scale )
+{
+    if( scale )
+        return &StereoFrameHandler::optimizeFunctions_nonweighted<Kernel,true,true,true>;
+    if( points && lines )
+        return &StereoFrameHandler::optimizeFunctions_nonweighted<Kernel,true,true,false>;
+    if( points )
+        return &StereoFrameHandler::optimizeFunctions_nonweighted<Kernel,true,false,false>;
+    if( lines )
+        return &StereoFrameHandler::optimizeFunctions_nonweighted<Kernel,false,true,false>;
+    return &StereoFrameHandler::optimizeFunctions_nonweighted<Kernel,false,false,false>;
+}
+
+void StereoFrameHandler::optimizeFunctions_uncweighted(const SE3 &DT, Matrix6d &H, Vector6d &g, double &e )
 {
 
     // define hessians, gradients, and residuals
@@ -706,23 +964,23 @@ void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H,
     double sigma2     = sigma * sigma;
 
     // point features
-    Matrix3d R  = DT.block(0,0,3,3);
-    int n_inliers_ = 0;
-    int N_p = 0;
+    const Matrix3d &R = DT.rotation();
+    int N_p = 0, n_p = matched_pt.size();
+    bool parallel_p = n_p >= Config::parallelCostTh();
     vector<double> r_p;
-    for( list<PointFeature*>::iterator it = matched_pt.begin(); it!=matched_pt.end(); it++)
+    neq_p.resize( n_p );
+    forEachMatch( n_p, parallel_p, [&]( int i )
     {
-        if( (*it)->inlier )
+        if( matched_pt.inlier[i] )
         {
-            Vector3d P_ = R * (*it)->P + DT.col(3).head(3);
+            Vector3d P_ = DT * matched_pt.P[i];
             Vector2d pl_proj = cam->projection( P_ );
             // projection error
-            Vector2d err_i    = pl_proj - (*it)->pl_obs;
+            Vector2d err_i    = pl_proj - matched_pt.pl_obs[i];
             double err_i_norm = err_i.norm();
             // check inverse of err_i_norm
             if( err_i_norm > Config::homogTh() )
             {
-                n_inliers_++;
                 double gx   = P_(0);
                 double gy   = P_(1);
                 double gz   = P_(2);
@@ -739,66 +997,49 @@ void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H,
                          + fgz2 * ( gx*gx*dx + gz*gz*dx + gx*gy*dy ),
                          + fgz2 * ( gx*gz*dy - gy*gz*dx );
                 J_aux = J_aux / std::max(0.0000001,err_i_norm);
-                // uncertainty
-                double px_hat = (*it)->pl(0) - cx;
-                double py_hat = (*it)->pl(1) - cy;
-                double disp   = (*it)->disp;
-                double disp2  = disp * disp;
-                Matrix3d covP_an;
-                covP_an(0,0) = disp2+2.f*px_hat*px_hat;
-                covP_an(0,1) = 2.f*px_hat*py_hat;
-                covP_an(0,2) = 2.f*f*px_hat;
-                covP_an(1,1) = disp2+2.f*py_hat*py_hat;
-                covP_an(1,2) = 2.f*f*py_hat;
-                covP_an(2,2) = 2.f*f*f;
-                covP_an(1,0) = covP_an(0,1);
-                covP_an(2,0) = covP_an(0,2);
-                covP_an(2,1) = covP_an(1,2);
-                covP_an << covP_an / (disp2*disp2);
-                MatrixXd Jhg(2,3), covp(2,2), covp_inv(2,2);
-                Jhg  << gz, 0.f, -gx, 0.f, gz, -gy;
-                Jhg  << Jhg * R;
-                covp << Jhg * covP_an * Jhg.transpose();
-                covp << covp / (gz2*gz2);
-                covp = bsigma * covp;
-                covp(0,0) = covp(0,0) + sigma2;
-                covp(1,1) = covp(1,1) + sigma2;
-                covp_inv = covp.inverse();
+                // uncertainty (back-projection covariance cached in the match)
+                Matrix<double,2,3> Jhg;
+                Jhg << gz, 0.0, -gx, 0.0, gz, -gy;
+                Jhg = Jhg * R;
+                Matrix2d covp = ( bsigma / (gz2*gz2) ) * ( Jhg * matched_pt.covP[i] * Jhg.transpose() );
+                covp(0,0) += sigma2;
+                covp(1,1) += sigma2;
                 // update the weights matrix
-                double wunc = err_i.transpose() * covp_inv * err_i;
+                double wunc = err_i.dot( covp.inverse() * err_i );
                 wunc = wunc / (dx*dx+dy*dy);                
                 // if employing robust cost function
                 double w = 1.0;
                 if( Config::robustCost() )
                     w = 1.0 / ( 1.0 + err_i_norm );
                 // update hessian, gradient, and error
-                H_p += J_aux * J_aux.transpose() * wunc * w / err_i_norm ;
-                g_p += J_aux * w * wunc;
-                e_p += err_i_norm * err_i_norm * wunc * w ;
-                N_p++;
-                if( Config::scalePointsLines() )
-                    r_p.push_back( err_i_norm * err_i_norm * w * wunc );
+                neq_p.set( i, J_aux, wunc * w / err_i_norm, w * wunc, err_i_norm * err_i_norm * wunc * w );
             }
             else
-                (*it)->inlier = false;
+                matched_pt.inlier[i] = false;
         }
-    }
+    } );
+    neq_p.sum( H_p, g_p, e_p, N_p, parallel_p );
     if( Config::scalePointsLines() )
-        S_p = vector_stdv_mad(r_p);
+    {
+        neq_p.errors( r_p );
+        S_p = stdvMADSelect(r_p);
+    }
 
     // line segment features
-    int N_l = 0;
+    int N_l = 0, n_l = matched_ls.size();
+    bool parallel_l = n_l >= Config::parallelCostTh();
     vector<double> r_l;
-    for( list<LineFeature*>::iterator it = matched_ls.begin(); it!=matched_ls.end(); it++)
+    neq_l.resize( n_l );
+    forEachMatch( n_l, parallel_l, [&]( int i )
     {
 
-        if( (*it)->inlier )
+        if( matched_ls.inlier[i] )
         {
-            Vector3d sP_ = DT.block(0,0,3,3) * (*it)->sP + DT.col(3).head(3);
+            Vector3d sP_ = DT * matched_ls.sP[i];
             Vector2d spl_proj = cam->projection( sP_ );
-            Vector3d eP_ = DT.block(0,0,3,3) * (*it)->eP + DT.col(3).head(3);
+            Vector3d eP_ = DT * matched_ls.eP[i];
             Vector2d epl_proj = cam->projection( eP_ );
-            Vector3d l_obs = (*it)->le_obs;
+            Vector3d l_obs = matched_ls.le_obs[i];
             // projection error
             Vector2d err_i;
             err_i(0) = l_obs(0) * spl_proj(0) + l_obs(1) * spl_proj(1) + l_obs(2);
@@ -824,35 +1065,16 @@ void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H,
                           - fgz2 * ( gx*gy*lx + gy*gy*ly + gz*gz*ly ),
                           + fgz2 * ( gx*gx*lx + gz*gz*lx + gx*gy*ly ),
                           + fgz2 * ( gx*gz*ly - gy*gz*lx );
-                // uncertainty
-                double px_hat = (*it)->spl(0) - cx;
-                double py_hat = (*it)->spl(1) - cy;
-                double disp   = (*it)->sdisp;
-                double disp2  = disp * disp;
-                Matrix3d covP_an;
-                covP_an(0,0) = disp2+2.f*px_hat*px_hat;
-                covP_an(0,1) = 2.f*px_hat*py_hat;
-                covP_an(0,2) = 2.f*f*px_hat;
-                covP_an(1,1) = disp2+2.f*py_hat*py_hat;
-                covP_an(1,2) = 2.f*f*py_hat;
-                covP_an(2,2) = 2.f*f*f;
-                covP_an(1,0) = covP_an(0,1);
-                covP_an(2,0) = covP_an(0,2);
-                covP_an(2,1) = covP_an(1,2);
-                covP_an << covP_an / (disp2*disp2);
+                // uncertainty (back-projection covariances cached in the match)
                 Vector3d spl_proj_ = cam->projectionNH( sP_ );
-                MatrixXd J_ep(1,3);
+                RowVector3d J_ep;
                 double lxpz = lx * spl_proj_(2);
                 double lypz = ly * spl_proj_(2);
                 J_ep << lxpz*f, lypz*f, lxpz*cx+lypz*cy-lx*spl_proj_(0)-ly*spl_proj_(1);
-                J_ep << J_ep * R;
-                double p4 = pow(spl_proj_(2),4);
-                double cov_p;
-                VectorXd cov_aux(1);
-                cov_aux << J_ep * covP_an * J_ep.transpose();
-                cov_p = cov_aux(0);
-                cov_p = 1.f/cov_p;
-                cov_p = p4 * cov_p * 0.5f * bsigma_inv;
+                J_ep = J_ep * R;
+                double pz2  = spl_proj_(2) * spl_proj_(2);
+                double cov_p = 1.0 / J_ep.dot( matched_ls.covS[i] * J_ep.transpose() );
+                cov_p = pz2 * pz2 * cov_p * 0.5 * bsigma_inv;
 
                 // -- end point
                 gx   = eP_(0);
@@ -868,36 +1090,17 @@ void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H,
                           + fgz2 * ( gx*gx*lx + gz*gz*lx + gx*gy*ly ),
                           + fgz2 * ( gx*gz*ly - gy*gz*lx );
                 // uncertainty
-                px_hat = (*it)->epl(0) - cx;
-                py_hat = (*it)->epl(1) - cy;
-                disp   = (*it)->edisp;
-                disp2  = disp * disp;
-                Matrix3d covQ_an;
-                covQ_an(0,0) = disp2+2.f*px_hat*px_hat;
-                covQ_an(0,1) = 2.f*px_hat*py_hat;
-                covQ_an(0,2) = 2.f*f*px_hat;
-                covQ_an(1,1) = disp2+2.f*py_hat*py_hat;
-                covQ_an(1,2) = 2.f*f*py_hat;
-                covQ_an(2,2) = 2.f*f*f;
-                covQ_an(1,0) = covQ_an(0,1);
-                covQ_an(2,0) = covQ_an(0,2);
-                covQ_an(2,1) = covQ_an(1,2);
-                covQ_an << covQ_an / (disp2*disp2);
                 Vector3d epl_proj_ = cam->projectionNH( eP_ );
                 lxpz = lx * epl_proj_(2);
                 lypz = ly * epl_proj_(2);
                 J_ep << lxpz*f, lypz*f, lxpz*cx+lypz*cy-lx*epl_proj_(0)-ly*epl_proj_(1);
-                J_ep << J_ep * R;
-                p4 = pow(epl_proj_(2),4);
-                double cov_q;
-                cov_aux << J_ep * covQ_an * J_ep.transpose();
-                cov_q = cov_aux(0);
-                cov_q = 1.f / cov_q;
-                cov_q = p4 * cov_q * 0.5f * bsigma_inv;
+                J_ep = J_ep * R;
+                pz2  = epl_proj_(2) * epl_proj_(2);
+                double cov_q = 1.0 / J_ep.dot( matched_ls.covE[i] * J_ep.transpose() );
+                cov_q = pz2 * pz2 * cov_q * 0.5 * bsigma_inv;
 
                 if( !std::isinf(cov_p) && !std::isnan(cov_p) && !std::isinf(cov_q) && !std::isnan(cov_q) )
                 {
-                    n_inliers_++;
                     // update the weights matrix
                     double wunc = err_i(0) * err_i(0) * cov_p + err_i(1) * err_i(1) * cov_q;
                     wunc = wunc / ( err_i(0)*err_i(0) + err_i(1)*err_i(1) );
@@ -908,23 +1111,22 @@ void StereoFrameHandler::optimizeFunctions_uncweighted(Matrix4d DT, Matrix6d &H,
                     if( Config::robustCost() )
                         w = 1.0 / ( 1.0 + err_i_norm );
                     // update hessian, gradient, and error
-                    H_l += J_aux * J_aux.transpose() * wunc * w / err_i_norm ;
-                    g_l += J_aux * w * wunc;
-                    e_l += err_i_norm * err_i_norm * wunc * w ;
-                    N_l++;
-                    if( Config::scalePointsLines() )
-                        r_l.push_back( err_i_norm * err_i_norm * w * wunc );
+                    neq_l.set( i, J_aux, wunc * w / err_i_norm, w * wunc, err_i_norm * err_i_norm * wunc * w );
                 }
                 else
-                    (*it)->inlier = false;
+                    matched_ls.inlier[i] = false;
             }
             else
-                (*it)->inlier = false;
+                matched_ls.inlier[i] = false;
         }
 
-    }
+    } );
+    neq_l.sum( H_l, g_l, e_l, N_l, parallel_l );
     if( Config::scalePointsLines() )
-        S_l = vector_stdv_mad(r_l);
+    {
+        neq_l.errors( r_l );
+        S_l = stdvMADSelect(r_l);
+    }
 
     // sum H, g and err from both points and lines
     if( Config::scalePointsLines() && S_l > Config::homogTh() && S_p > Config::homogTh() &&
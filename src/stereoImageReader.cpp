@@ -0,0 +1,93 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <stereoImageReader.h>
+
+namespace StVO{
+
+StereoImageReader::StereoImageReader( const vector<string> &files_l_, const vector<string> &files_r_, int n_prefetch, int flags_ ) :
+    files_l(files_l_), files_r(files_r_), ring( std::max(1,n_prefetch) ), flags(flags_), n_read(0), n_requested(0), failed_idx(-1)
+{
+    files_l.resize( std::min( files_l.size(), files_r.size() ) );
+    files_r.resize( files_l.size() );
+    while( n_requested < size() && n_requested < ring.size() )
+        request( n_requested );
+}
+
+StereoImageReader::~StereoImageReader()
+{
+    // the pending decodings write into the ring
+    for( int k = 0; k < ring.size(); k++ )
+    {
+        if( ring[k].decoded_l.valid() )
+            ring[k].decoded_l.wait();
+        if( ring[k].decoded_r.valid() )
+            ring[k].decoded_r.wait();
+    }
+}
+
+void StereoImageReader::decode( const string &file, int flags, Mat &img )
+{
+    img = imread( file, flags );
+}
+
+void StereoImageReader::request( int i )
+{
+    Slot &slot = ring[ i % ring.size() ];
+    slot.decoded_l = ThreadPool::getInstance().submitBackground( &StereoImageReader::decode, files_l[i], flags, ref(slot.img_l) );
+    slot.decoded_r = ThreadPool::getInstance().submitBackground( &StereoImageReader::decode, files_r[i], flags, ref(slot.img_r) );
+    n_requested++;
+}
+
+bool StereoImageReader::next( Mat &img_l, Mat &img_r )
+{
+
+    if( n_read >= size() || failed() )
+        return false;
+
+    // the returned headers keep the images alive once the slot is reused
+    Slot &slot = ring[ n_read % ring.size() ];
+    ThreadPool::getInstance().wait( slot.decoded_l );
+    ThreadPool::getInstance().wait( slot.decoded_r );
+    img_l = slot.img_l;
+    img_r = slot.img_r;
+    slot.img_l = Mat();
+    slot.img_r = Mat();
+    int i = n_read++;
+
+    // a pair that cannot be read ends the sequence, but is reported apart from its end
+    if( img_l.empty() || img_r.empty() )
+    {
+        failed_idx  = i;
+        failed_file = img_l.empty() ? files_l[i] : files_r[i];
+        return false;
+    }
+
+    // refill the slot with the first pair not requested yet
+    if( n_requested < size() )
+        request( n_requested );
+
+    return true;
+
+}
+
+}
@@ -0,0 +1,153 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+#include <threadPool.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <config.h>
+
+namespace StVO{
+
+// index of the worker running on this thread (-1 outside the pool)
+static thread_local int worker_idx = -1;
+
+// group of the task running on this thread (0 outside the pool)
+static thread_local int task_group = 0;
+
+// any group, for the workers' loop
+static const int ANY_GROUP = -1;
+
+ThreadPool& ThreadPool::getInstance()
+{
+    static ThreadPool instance; // Instantiated on first use and guaranteed to be destroyed
+    return instance;
+}
+
+ThreadPool::ThreadPool() : pending(0), next_queue(0), next_group(1), stop(false)
+{
+    int n_cores   = std::max( 1, (int)thread::hardware_concurrency() );
+    int n_workers = Config::poolThreads() > 0 ? Config::poolThreads() : n_cores;
+    for( int w = 0; w < n_workers; w++ )
+        queues.push_back( unique_ptr<WorkQueue>( new WorkQueue ) );
+    for( int w = 0; w < n_workers; w++ )
+    {
+        workers.push_back( thread( &ThreadPool::workerLoop, this, w ) );
+#ifdef __linux__
+        if( Config::poolPinning() )
+        {
+            cpu_set_t cpus;
+            CPU_ZERO( &cpus );
+            CPU_SET( w % n_cores, &cpus );
+            pthread_setaffinity_np( workers.back().native_handle(), sizeof(cpu_set_t), &cpus );
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock( sleep_m );
+        stop = true;
+    }
+    sleep_cv.notify_all();
+    for( int w = 0; w < workers.size(); w++ )
+        workers[w].join();
+}
+
+int ThreadPool::currentGroup()
+{
+    return task_group;
+}
+
+void ThreadPool::push( function<void()> task, int group )
+{
+    // tasks submitted by a worker go to its own queue
+    int w = worker_idx >= 0 ? worker_idx : next_queue++ % (int)queues.size();
+    {
+        lock_guard<mutex> lock( queues[w]->m );
+        Task task_ = { move(task), group };
+        queues[w]->tasks.push_back( move(task_) );
+    }
+    {
+        lock_guard<mutex> lock( sleep_m );
+        pending++;
+    }
+    sleep_cv.notify_one();
+}
+
+bool ThreadPool::popTask( int w, int group, Task &task )
+{
+    // own queue from the back, the others from the front, skipping the tasks of other groups
+    int n = queues.size();
+    int first = w >= 0 ? w : 0;
+    for( int k = 0; k < n; k++ )
+    {
+        WorkQueue &q = *queues[(first+k)%n];
+        lock_guard<mutex> lock( q.m );
+        int m = q.tasks.size();
+        bool from_back = ( k == 0 && w >= 0 );
+        for( int j = 0; j < m; j++ )
+        {
+            int i = from_back ? m - 1 - j : j;
+            if( group != ANY_GROUP && q.tasks[i].group != group )
+                continue;
+            task = move( q.tasks[i] );
+            q.tasks.erase( q.tasks.begin() + i );
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask( int group )
+{
+    Task task;
+    if( !popTask( worker_idx, group, task ) )
+        return false;
+    int group_ = task_group;
+    task_group = task.group;
+    task.run();
+    task_group = group_;
+    return true;
+}
+
+void ThreadPool::workerLoop( int w )
+{
+    worker_idx = w;
+    while( true )
+    {
+        if( runPendingTask( ANY_GROUP ) )
+            continue;
+        unique_lock<mutex> lock( sleep_m );
+        sleep_cv.wait( lock, [this](){ return stop || pending > 0; } );
+        if( stop )
+            break;
+    }
+}
+
+}
@@ -0,0 +1,174 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+// Checks that the matching strategies give the same KnnMatches on the same input: the linear and
+// bucketed cross-checks against a brute-force reference, the multi-index hashing one up to the
+// order of equidistant descriptors, and the adaptive cross-checks with and without the cost model.
+
+#include <matcherCostModel.h>
+#include <hammingMatcher.h>
+#include <config.h>
+
+#include <cstdio>
+#include <cstring>
+using namespace StVO;
+
+static int hamming( const Mat &desc_1, int i, const Mat &desc_2, int j )
+{
+    int dist = 0;
+    for( int b = 0; b < desc_1.cols; b++ )
+        dist += __builtin_popcount( desc_1.ptr<uchar>(i)[b] ^ desc_2.ptr<uchar>(j)[b] );
+    return dist;
+}
+
+// best two matches of each row of desc_1 and best match of each row of desc_2 over the allowed
+// pairs, the lowest index first among equidistant descriptors
+static void referenceMatch( const Mat &desc_1, const Mat &desc_2, const vector<vector<char> > &allowed,
+                            KnnMatches &matches_12, KnnMatches &matches_21 )
+{
+    int max_dist = 8 * desc_1.cols;
+    KnnMatch2 none = { { -1, -1 }, { max_dist, max_dist } };
+    matches_12.assign( desc_1.rows, none );
+    matches_21.assign( desc_2.rows, none );
+    for( int i = 0; i < desc_1.rows; i++ )
+    {
+        for( int j = 0; j < desc_2.rows; j++ )
+        {
+            if( !allowed[i][j] )
+                continue;
+            int dist = hamming( desc_1, i, desc_2, j );
+            KnnMatch2 &m = matches_12[i];
+            if( m.trainIdx[0] < 0 || dist < m.distance[0] )
+            {
+                m.trainIdx[1] = m.trainIdx[0];  m.distance[1] = m.distance[0];
+                m.trainIdx[0] = j;              m.distance[0] = dist;
+            }
+            else if( m.trainIdx[1] < 0 || dist < m.distance[1] )
+            {
+                m.trainIdx[1] = j;              m.distance[1] = dist;
+            }
+            KnnMatch2 &m_ = matches_21[j];
+            if( m_.trainIdx[0] < 0 || dist < m_.distance[0] )
+            {
+                m_.trainIdx[0] = i;             m_.distance[0] = dist;
+            }
+        }
+    }
+}
+
+// number of entries (both entries of matches_12, the first one of matches_21) that differ from the
+// reference; if ties are allowed, another index at the same distance is accepted
+static int countDiffs( const Mat &desc_1, const Mat &desc_2, const KnnMatches &ref_12, const KnnMatches &ref_21,
+                       const KnnMatches &matches_12, const KnnMatches &matches_21, bool ties )
+{
+    if( matches_12.size() != ref_12.size() || matches_21.size() != ref_21.size() )
+        return 1;
+    int n_diff = 0;
+    for( int i = 0; i < ref_12.size(); i++ )
+    {
+        for( int l = 0; l < 2; l++ )
+        {
+            int j = matches_12[i].trainIdx[l];
+            bool same = matches_12[i].distance[l] == ref_12[i].distance[l] && ( j == ref_12[i].trainIdx[l] ||
+                        ( ties && j >= 0 && j != matches_12[i].trainIdx[1-l] && hamming( desc_1, i, desc_2, j ) == ref_12[i].distance[l] ) );
+            n_diff += same ? 0 : 1;
+        }
+    }
+    for( int j = 0; j < ref_21.size(); j++ )
+    {
+        int i = matches_21[j].trainIdx[0];
+        bool same = matches_21[j].distance[0] == ref_21[j].distance[0] && ( i == ref_21[j].trainIdx[0] ||
+                    ( ties && i >= 0 && hamming( desc_1, i, desc_2, j ) == ref_21[j].distance[0] ) );
+        n_diff += same ? 0 : 1;
+    }
+    return n_diff;
+}
+
+int main()
+{
+
+    static const int sizes[][2] = { {1,1}, {1,7}, {7,1}, {37,300}, {300,257}, {513,64} };
+    RNG rng( 12345 );
+    int n_fail = 0;
+    for( int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++ )
+    {
+        // random descriptors, some rows of desc_2 repeated so that there are ties
+        int n_1 = sizes[s][0], n_2 = sizes[s][1];
+        Mat desc_1( n_1, 32, CV_8UC1 ), desc_2( n_2, 32, CV_8UC1 );
+        rng.fill( desc_1, RNG::UNIFORM, 0, 256 );
+        rng.fill( desc_2, RNG::UNIFORM, 0, 256 );
+        for( int j = 1; j < n_2; j += 5 )
+            memcpy( desc_2.ptr<uchar>(j), desc_2.ptr<uchar>(j-1), 32 );
+
+        // all pairs, and random candidates in CSR form
+        vector<vector<char> > all( n_1, vector<char>( n_2, 1 ) ), allowed( n_1, vector<char>( n_2, 0 ) );
+        vector<int> offsets_all( 1, 0 ), cand_all, offsets( 1, 0 ), cand;
+        for( int i = 0; i < n_1; i++ )
+        {
+            for( int j = 0; j < n_2; j++ )
+            {
+                cand_all.push_back( j );
+                if( rng.uniform( 0.0, 1.0 ) < 0.2 )
+                {
+                    cand.push_back( j );
+                    allowed[i][j] = 1;
+                }
+            }
+            offsets_all.push_back( cand_all.size() );
+            offsets.push_back( cand.size() );
+        }
+
+        KnnMatches ref_12, ref_21, ref_cand_12, ref_cand_21, m_12, m_21;
+        referenceMatch( desc_1, desc_2, all, ref_12, ref_21 );
+        referenceMatch( desc_1, desc_2, allowed, ref_cand_12, ref_cand_21 );
+
+        int diffs[7];
+        HammingMatcher::crossCheckMatch( desc_1, desc_2, m_12, m_21 );
+        diffs[0] = countDiffs( desc_1, desc_2, ref_12, ref_21, m_12, m_21, false );
+        HammingMatcher::crossCheckMatch( desc_1, desc_2, offsets_all, cand_all, m_12, m_21 );
+        diffs[1] = countDiffs( desc_1, desc_2, ref_12, ref_21, m_12, m_21, false );
+        HammingMatcher::crossCheckMatch( desc_1, desc_2, offsets, cand, m_12, m_21 );
+        diffs[2] = countDiffs( desc_1, desc_2, ref_cand_12, ref_cand_21, m_12, m_21, false );
+        MatcherCostModel::mihCrossCheckMatch( desc_1, desc_2, m_12, m_21 );
+        diffs[3] = countDiffs( desc_1, desc_2, ref_12, ref_21, m_12, m_21, true );
+
+        // the adaptive cross-checks, whatever the cost model selects
+        for( int a = 0; a < 2; a++ )
+        {
+            Config::adaptiveMatching() = ( a == 0 );
+            MatcherCostModel::adaptiveCrossCheckMatch( desc_1, desc_2, m_12, m_21 );
+            diffs[4+a] = countDiffs( desc_1, desc_2, ref_12, ref_21, m_12, m_21, true );
+            MatcherCostModel::adaptiveCrossCheckMatch( desc_1, desc_2, offsets, cand, m_12, m_21 );
+            diffs[6] = countDiffs( desc_1, desc_2, ref_cand_12, ref_cand_21, m_12, m_21, false );
+            n_fail += diffs[6] > 0 ? 1 : 0;
+        }
+
+        printf( "%d x %d: linear %d \t bucketed (all) %d \t bucketed %d \t mih %d \t adaptive %d %d \t adaptive (cand) %d\n",
+                n_1, n_2, diffs[0], diffs[1], diffs[2], diffs[3], diffs[4], diffs[5], diffs[6] );
+        for( int k = 0; k < 6; k++ )
+            n_fail += diffs[k] > 0 ? 1 : 0;
+    }
+
+    printf( "kernel: %s \t %s\n", HammingMatcher::kernelName(), n_fail == 0 ? "ok" : "FAILED" );
+    return n_fail == 0 ? 0 : 1;
+
+}
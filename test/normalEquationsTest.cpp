@@ -0,0 +1,100 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+// Checks the normal equations of each available kernel (scalar and AVX2+FMA) against the Eigen
+// sums of wh J J^T and wg J, for batches of 0 to 100 residuals with some unset slots, and that
+// the chunked sums on the thread pool give the same bits as the serial ones.
+
+#include <normalEquations.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+using namespace StVO;
+
+static bool check( int n, double &err )
+{
+
+    NormalEquations neq;
+    neq.resize( n );
+    Matrix6d H_ref = Matrix6d::Zero();
+    Vector6d g_ref = Vector6d::Zero();
+    double   e_ref = 0.0;
+    int      n_ref = 0;
+    for( int k = 0; k < n; k++ )
+    {
+        if( rand() % 5 == 0 )
+            continue;
+        Vector6d J   = Vector6d::Random();
+        double   w_h = rand() / double(RAND_MAX);
+        double   w_g = rand() / double(RAND_MAX) - 0.5;
+        neq.set( k, J, w_h, w_g, w_h * w_g );
+        H_ref += w_h * J * J.transpose();
+        g_ref += w_g * J;
+        e_ref += w_h * w_g;
+        n_ref++;
+    }
+
+    Matrix6d H, H_par;
+    Vector6d g, g_par;
+    double   e, e_par;
+    int      m, m_par;
+    neq.sum( H, g, e, m, false );
+    neq.sum( H_par, g_par, e_par, m_par, true );
+
+    err = std::max( err, ( H - H_ref ).norm() / ( 1.0 + H_ref.norm() ) );
+    err = std::max( err, ( g - g_ref ).norm() / ( 1.0 + g_ref.norm() ) );
+    err = std::max( err, fabs( e - e_ref ) / ( 1.0 + fabs( e_ref ) ) );
+    bool same = memcmp( H.data(), H_par.data(), sizeof(H) ) == 0 &&
+                memcmp( g.data(), g_par.data(), sizeof(g) ) == 0 &&
+                e == e_par && m == m_par;
+    return m == n_ref && same;
+
+}
+
+int main()
+{
+
+    const char* kernels[] = { "scalar", "avx2-fma" };
+    int failed = 0;
+    for( int i = 0; i < 2; i++ )
+    {
+        if( !NormalEquations::setKernel( kernels[i] ) )
+        {
+            printf( "%s: not supported, skipped\n", kernels[i] );
+            continue;
+        }
+        srand( 0 );
+        double err = 0.0;
+        int    bad = 0;
+        for( int n = 0; n <= 100; n++ )
+            bad += check( n, err ) ? 0 : 1;
+        // several chunks
+        bad += check( 1000, err ) ? 0 : 1;
+        printf( "%s: relative error: %g \t mismatched batches: %d\n", kernels[i], err, bad );
+        if( bad > 0 || err > 1e-12 )
+            failed++;
+    }
+    return failed == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+**   Stereo Visual Odometry by combining point and line segment features	**
+******************************************************************************
+**																			**
+**	Copyright(c) 2016, Ruben Gomez-Ojeda, University of Malaga              **
+**	Copyright(c) 2016, MAPIR group, University of Malaga					**
+**																			**
+**  This program is free software: you can redistribute it and/or modify	**
+**  it under the terms of the GNU General Public License (version 3) as		**
+**	published by the Free Software Foundation.								**
+**																			**
+**  This program is distributed in the hope that it will be useful, but		**
+**	WITHOUT ANY WARRANTY; without even the implied warranty of				**
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the			**
+**  GNU General Public License for more details.							**
+**																			**
+**  You should have received a copy of the GNU General Public License		**
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.	**
+**																			**
+*****************************************************************************/
+
+
+// Checks the SE3 exp/log round trip and its jacobians against central finite differences,
+// from rotations of a few microradians (series coefficients) up to almost pi.
+
+#include <se3.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+using namespace StVO;
+
+int main()
+{
+
+    const double angles[] = { 0.0, 1e-9, 2e-5, 1e-4, 1e-3, 1e-2, 0.0999, 0.1001, 0.5, 1.0, 2.0, 3.0, M_PI - 1e-7 };
+    const double h = 1e-6;
+    double err_log = 0.0, err_jac = 0.0;
+    srand( 0 );
+    for( int k = 0; k < sizeof(angles) / sizeof(double); k++ )
+    {
+        for( int n = 0; n < 20; n++ )
+        {
+            Vector6d x;
+            x << Vector3d::Random(), angles[k] * Vector3d::Random().normalized();
+            SE3 T = SE3::exp( x );
+            err_log = std::max( err_log, ( T.log() - x ).norm() );
+
+            // exp(x+dx) exp(x)^-1 ~ exp(Jl dx) and exp(x)^-1 exp(x+dx) ~ exp(Jr dx)
+            Matrix6d Jl, Jr;
+            for( int i = 0; i < 6; i++ )
+            {
+                Vector6d dx = Vector6d::Zero();
+                dx(i) = h;
+                SE3 T_p = SE3::exp( x + dx ), T_m = SE3::exp( x - dx );
+                Jl.col(i) = ( ( T_p * T.inverse() ).log() - ( T_m * T.inverse() ).log() ) / ( 2.0 * h );
+                Jr.col(i) = ( ( T.inverse() * T_p ).log() - ( T.inverse() * T_m ).log() ) / ( 2.0 * h );
+            }
+            err_jac = std::max( err_jac, ( Jl - SE3::leftJacobian( x ) ).norm() );
+            err_jac = std::max( err_jac, ( Jr - SE3::rightJacobian( x ) ).norm() );
+        }
+    }
+
+    printf( "log error: %g \t jacobian error: %g\n", err_log, err_jac );
+    return ( err_log < 1e-12 && err_jac < 1e-7 ) ? 0 : 1;
+
+}